@@ -0,0 +1,115 @@
+#include "Arena.h"
+
+#include <assert.h>
+#include <stddef.h> // max_align_t
+#include <stdlib.h> // malloc, free
+
+static u8 *block_data(Arena_Block *block) {
+    return (u8 *)(block + 1);
+}
+
+static Arena_Block *arena_new_block(Arena *arena, s64 minimum_size) {
+    s64 size = arena->block_size;
+    if (size < minimum_size) { size = minimum_size; }
+
+    Arena_Block *block = (Arena_Block *)malloc(sizeof(Arena_Block) + size);
+    assert(block);
+
+    block->next = arena->current;
+    block->size = size;
+    block->used = 0;
+
+    arena->current = block;
+    return block;
+}
+
+void arena_init(Arena *arena, s64 block_size) {
+    assert(arena && block_size > 0);
+    arena->current    = NULL;
+    arena->block_size = block_size;
+}
+
+void arena_deinit(Arena *arena) {
+    assert(arena);
+    Arena_Block *block = arena->current;
+    while (block) {
+        Arena_Block *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->current = NULL;
+}
+
+void arena_reset(Arena *arena) {
+    assert(arena);
+    if (!arena->current) { return; }
+
+    // Free everything but the oldest block, that one we keep around for reuse.
+    Arena_Block *block = arena->current;
+    while (block->next) {
+        Arena_Block *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    block->used    = 0;
+    arena->current = block;
+}
+
+void *arena_alloc(Arena *arena, s64 size, s64 alignment) {
+    assert(arena && size >= 0);
+    // Alignment must be a power of two.
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    Arena_Block *block = arena->current;
+    if (block) {
+        u64 base    = (u64)block_data(block);
+        u64 aligned = (base + block->used + (alignment - 1)) & ~(u64)(alignment - 1);
+        s64 offset  = (s64)(aligned - base);
+        if (offset + size <= block->size) {
+            block->used = offset + size;
+            return (void *)aligned;
+        }
+    }
+
+    // Doesn't fit, chain a fresh block big enough for this allocation plus worst case alignment.
+    block = arena_new_block(arena, size + alignment);
+
+    u64 base    = (u64)block_data(block);
+    u64 aligned = (base + (alignment - 1)) & ~(u64)(alignment - 1);
+    block->used = (s64)(aligned - base) + size;
+
+    return (void *)aligned;
+}
+
+static void *heap_allocate(void *data, s64 size, s64 alignment) {
+    (void)data;
+    assert(alignment <= (s64)alignof(max_align_t));
+    void *memory = malloc(size);
+    assert(memory);
+    return memory;
+}
+
+static void heap_deallocate(void *data, void *memory, s64 size) {
+    (void)data; (void)size;
+    free(memory);
+}
+
+Allocator heap_allocator() {
+    Allocator allocator = {heap_allocate, heap_deallocate, NULL};
+    return allocator;
+}
+
+static void *arena_allocate(void *data, s64 size, s64 alignment) {
+    return arena_alloc((Arena *)data, size, alignment);
+}
+
+static void arena_deallocate(void *data, void *memory, s64 size) {
+    // Arena memory goes back when the arena is reset or deinitialized.
+    (void)data; (void)memory; (void)size;
+}
+
+Allocator arena_allocator(Arena *arena) {
+    Allocator allocator = {arena_allocate, arena_deallocate, arena};
+    return allocator;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Types.h"
+
+/**
+   A bump allocator which hands out memory from large chained blocks.
+
+   Allocating is a pointer bump in the common case. When the current block runs out we chain
+   a new block in front of it, so pointers handed out earlier are never moved or invalidated.
+
+   Nothing is freed individually. arena_reset rewinds the arena in one go (keeping the first block
+   around so the next batch of allocations doesn't have to go back to the heap) and arena_deinit
+   gives every block back.
+**/
+
+const s64 ARENA_DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+struct Arena_Block {
+    Arena_Block *next; // The block which was filled before this one.
+    s64 size;          // Usable bytes in data.
+    s64 used;          // Bytes handed out so far.
+    // The data follows the header directly.
+};
+
+struct Arena {
+    Arena_Block *current;
+    s64 block_size;   // Minimum size of each new block.
+};
+
+void  arena_init(Arena *arena, s64 block_size=ARENA_DEFAULT_BLOCK_SIZE);
+void  arena_deinit(Arena *arena);
+void  arena_reset(Arena *arena);
+void *arena_alloc(Arena *arena, s64 size, s64 alignment=8);
+
+template <typename T>
+inline T *arena_new(Arena *arena) {
+    T *result = (T *)arena_alloc(arena, sizeof(T), alignof(T));
+    return result;
+}
+
+/**
+   Allocator lets a data structure take its memory from wherever the caller wants, for example a table
+   that should live exactly as long as the arena of a compilation.
+
+   deallocate gets the size that was asked for so allocators which don't track sizes can still use it,
+   the arena allocator ignores it since arena memory is only given back all at once.
+**/
+
+struct Allocator {
+    void *(*allocate)(void *data, s64 size, s64 alignment);
+    void  (*deallocate)(void *data, void *memory, s64 size);
+    void  *data;
+};
+
+Allocator heap_allocator();
+Allocator arena_allocator(Arena *arena);
+
+inline void *allocator_alloc(Allocator allocator, s64 size, s64 alignment=8) {
+    return allocator.allocate(allocator.data, size, alignment);
+}
+
+inline void allocator_free(Allocator allocator, void *memory, s64 size) {
+    allocator.deallocate(allocator.data, memory, size);
+}
@@ -1,14 +1,323 @@
 #include "Ast.h"
 
 #include <assert.h>
+#include <math.h>   // fmod
+#include <stdio.h>
+#include <stdlib.h> // malloc, exit
+#include <string.h> // memcpy
 
-Ast *NEW_AST(Ast_Type ast_type) { 
-    switch (ast_type) { 
-        case Ast_Type::AST_EXPRESSION: { 
-            Ast *ast = new Ast_Expression;
-            ast->ast_type = ast_type;
-            return ast;
-        } 
+void ast_tree_init(Ast_Tree *tree, s64 capacity) {
+    assert(tree && capacity >= 0);
+    *tree = {};
+    if (capacity < 64) { capacity = 64; }
+
+    tree->capacity = capacity;
+    tree->kinds    = (Ast_Kind *)   malloc(capacity * sizeof(Ast_Kind));
+    tree->payloads = (Ast_Payload *)malloc(capacity * sizeof(Ast_Payload));
+    assert(tree->kinds && tree->payloads);
+
+    ast_tree_reset(tree);
+}
+
+void ast_tree_deinit(Ast_Tree *tree) {
+    assert(tree);
+    free(tree->kinds);
+    free(tree->payloads);
+    free(tree->strings);
+    *tree = {};
+}
+
+// Drops every node but keeps the memory around.
+void ast_tree_reset(Ast_Tree *tree) {
+    tree->kinds[0]    = AST_NONE;
+    tree->payloads[0] = {};
+    tree->count         = 1;
+    tree->strings_count = 0;
+}
+
+static void ast_tree_grow(Ast_Tree *tree) {
+    s64 capacity = tree->capacity * 2;
+
+    tree->kinds    = (Ast_Kind *)   realloc(tree->kinds,    capacity * sizeof(Ast_Kind));
+    tree->payloads = (Ast_Payload *)realloc(tree->payloads, capacity * sizeof(Ast_Payload));
+    assert(tree->kinds && tree->payloads);
+
+    tree->capacity = capacity;
+}
+
+Ast_Index ast_add(Ast_Tree *tree, Ast_Kind kind, Ast_Payload payload) {
+    assert(tree && tree->kinds);
+    if (tree->count >= tree->capacity) { ast_tree_grow(tree); }
+    assert(tree->count < UINT32_MAX);
+
+    Ast_Index index = (Ast_Index)tree->count++;
+    tree->kinds[index]    = kind;
+    tree->payloads[index] = payload;
+    return index;
+}
+
+// Copies the bytes into the string pool with a nul after them, returns their offset.
+static u32 ast_add_string_data(Ast_Tree *tree, char *data, s64 count) {
+    s64 needed = tree->strings_count + count + 1;
+    if (needed > tree->strings_capacity) {
+        s64 capacity = tree->strings_capacity * 2;
+        if (capacity < 256)    { capacity = 256; }
+        if (capacity < needed) { capacity = needed; }
+
+        tree->strings = (char *)realloc(tree->strings, capacity);
+        assert(tree->strings);
+        tree->strings_capacity = capacity;
+    }
+    assert(needed <= UINT32_MAX);
+
+    u32 offset = (u32)tree->strings_count;
+    memcpy(tree->strings + offset, data, count);
+    tree->strings[offset + count] = '\0';
+    tree->strings_count = needed;
+    return offset;
+}
+
+Ast_Index ast_add_int(Ast_Tree *tree, u64 value) {
+    Ast_Payload payload;
+    payload.integer_value = value;
+    return ast_add(tree, AST_INT, payload);
+}
+
+Ast_Index ast_add_float(Ast_Tree *tree, f64 value) {
+    Ast_Payload payload;
+    payload.float_value = value;
+    return ast_add(tree, AST_FLOAT, payload);
+}
+
+Ast_Index ast_add_bool(Ast_Tree *tree, bool value) {
+    Ast_Payload payload;
+    payload.integer_value = value ? 1 : 0;
+    return ast_add(tree, AST_BOOL, payload);
+}
+
+Ast_Index ast_add_string(Ast_Tree *tree, char *data, s64 count) {
+    Ast_Payload payload;
+    payload.string.offset = ast_add_string_data(tree, data, count);
+    payload.string.count  = (u32)count;
+    return ast_add(tree, AST_STRING, payload);
+}
+
+Ast_Index ast_add_identifier(Ast_Tree *tree, Atom atom, char *name, s64 count) {
+    Ast_Payload payload;
+    payload.identifier.atom = atom;
+    payload.identifier.name = ast_add_string_data(tree, name, count);
+    return ast_add(tree, AST_IDENTIFIER, payload);
+}
+
+Ast_Index ast_add_unary(Ast_Tree *tree, Ast_Kind kind, Ast_Index operand) {
+    assert(ast_is_unary(kind) && operand != AST_NULL && operand < tree->count);
+    Ast_Payload payload = {};
+    payload.unary.operand = operand;
+    return ast_add(tree, kind, payload);
+}
+
+Ast_Index ast_add_binary(Ast_Tree *tree, Ast_Kind kind, Ast_Index left, Ast_Index right) {
+    assert(ast_has_two_children(kind) && left != AST_NULL && right != AST_NULL && left < tree->count && right < tree->count);
+    Ast_Payload payload;
+    payload.binary.left  = left;
+    payload.binary.right = right;
+    return ast_add(tree, kind, payload);
+}
+
+// Adds the branches first so that everything stays in post-order.
+Ast_Index ast_add_conditional(Ast_Tree *tree, Ast_Index condition, Ast_Index then, Ast_Index otherwise) {
+    Ast_Index branches = ast_add_binary(tree, AST_BRANCHES, then, otherwise);
+    return ast_add_binary(tree, AST_CONDITIONAL, condition, branches);
+}
+
+Ast_Index ast_subtree_start(Ast_Tree *tree, Ast_Index root) {
+    // The first node in post-order is the leftmost leaf.
+    Ast_Index index = root;
+    while (1) {
+        Ast_Kind kind = tree->kinds[index];
+        if (ast_has_two_children(kind)) { index = tree->payloads[index].binary.left; }
+        else if (ast_is_unary(kind))    { index = tree->payloads[index].unary.operand; }
+        else { return index; }
+    }
+}
+
+f64 ast_evaluate(Ast_Tree *tree, Ast_Index root, f64 *variables, s64 variable_count) {
+    assert(tree && root != AST_NULL && root < tree->count);
+
+    // One sweep over the subtree, values[i - start] is the value of node i.
+    Ast_Index start = ast_subtree_start(tree, root);
+    f64 small_values[64];
+    f64 *values = small_values;
+    if (root - start + 1 > 64) {
+        values = (f64 *)malloc((root - start + 1) * sizeof(f64));
+        assert(values);
+    }
+
+    // The root is the last node of its subtree, so after the sweep value is its value.
+    f64 value = 0;
+    for (Ast_Index i = start; i <= root; ++i) {
+        Ast_Payload *payload = &tree->payloads[i];
+
+        switch (tree->kinds[i]) {
+            case AST_INT:
+            case AST_BOOL:  value = (f64)payload->integer_value; break;
+            case AST_FLOAT: value = payload->float_value; break;
+            case AST_STRING: {
+                printf("Can't evaluate a string literal as a number\n");
+                exit(1);
+            }
+            case AST_IDENTIFIER: {
+                if (payload->identifier.atom >= variable_count) {
+                    printf("No value for '%s'\n", ast_string(tree, payload->identifier.name));
+                    exit(1);
+                }
+                value = variables[payload->identifier.atom];
+            } break;
+
+            case AST_NEGATE: value = -values[payload->unary.operand - start]; break;
+            case AST_PLUS:   value =  values[payload->unary.operand - start]; break;
+
+            case AST_ADD:      value = values[payload->binary.left - start] + values[payload->binary.right - start]; break;
+            case AST_SUBTRACT: value = values[payload->binary.left - start] - values[payload->binary.right - start]; break;
+            case AST_MULTIPLY: value = values[payload->binary.left - start] * values[payload->binary.right - start]; break;
+            case AST_DIVIDE:   value = values[payload->binary.left - start] / values[payload->binary.right - start]; break;
+            case AST_MODULO:   value = fmod(values[payload->binary.left - start], values[payload->binary.right - start]); break;
+
+            case AST_BRANCHES: value = 0; break; // Only used through its AST_CONDITIONAL.
+            case AST_CONDITIONAL: {
+                Ast_Payload *branches = &tree->payloads[payload->binary.right];
+                bool taken = values[payload->binary.left - start] != 0;
+                value = values[(taken ? branches->binary.left : branches->binary.right) - start];
+            } break;
+
+            default: assert(!"Unknown node kind");
+        }
+
+        values[i - start] = value;
+    }
+
+    if (values != small_values) { free(values); }
+    return value;
+}
+
+/**
+   Serialized layout, everything in native byte order:
+
+       Ast_Serialized_Header
+       kinds     count bytes
+       payloads  count * 8 bytes, starting at the next multiple of 8
+       strings   strings_count bytes
+**/
+
+const u32 AST_SERIALIZED_MAGIC = 0x54534124; // "$AST"
+
+struct Ast_Serialized_Header {
+    u32 magic;
+    u32 reserved;
+    u64 count;
+    u64 strings_count;
+};
+
+static s64 ast_payloads_offset(s64 count) {
+    return (sizeof(Ast_Serialized_Header) + count + 7) & ~(s64)7;
+}
+
+s64 ast_serialize(Ast_Tree *tree, void **data_return) {
+    assert(tree && data_return);
+
+    s64 payloads_offset = ast_payloads_offset(tree->count);
+    s64 strings_offset  = payloads_offset + tree->count * sizeof(Ast_Payload);
+    s64 size            = strings_offset + tree->strings_count;
+
+    u8 *data = (u8 *)calloc(size, 1);
+    assert(data);
+
+    Ast_Serialized_Header header = {AST_SERIALIZED_MAGIC, 0, (u64)tree->count, (u64)tree->strings_count};
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), tree->kinds, tree->count);
+    memcpy(data + payloads_offset, tree->payloads, tree->count * sizeof(Ast_Payload));
+    if (tree->strings_count) { memcpy(data + strings_offset, tree->strings, tree->strings_count); }
+
+    *data_return = data;
+    return size;
+}
+
+// Returns false if data isn't a serialized tree. tree is initialized either way.
+bool ast_deserialize(Ast_Tree *tree, void *_data, s64 size) {
+    u8 *data = (u8 *)_data;
+
+    Ast_Serialized_Header header;
+    if (size < (s64)sizeof(header)) { ast_tree_init(tree); return false; }
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != AST_SERIALIZED_MAGIC || header.count < 1 || header.count >= UINT32_MAX) {
+        ast_tree_init(tree);
+        return false;
+    }
+
+    // Unsigned so a huge strings_count can't wrap around to the right size, the strings have to be exactly
+    // what is left of the block after the payloads.
+    s64 count           = (s64)header.count;
+    s64 payloads_offset = ast_payloads_offset(count);
+    s64 strings_offset  = payloads_offset + count * sizeof(Ast_Payload);
+    if ((u64)strings_offset > (u64)size || header.strings_count != (u64)(size - strings_offset)) {
+        ast_tree_init(tree);
+        return false;
+    }
+
+    ast_tree_init(tree, count);
+    memcpy(tree->kinds, data + sizeof(header), count);
+    memcpy(tree->payloads, data + payloads_offset, count * sizeof(Ast_Payload));
+    tree->count = count;
+
+    // Only accept what ast_add could have built, so passes over the tree can trust the indices: every subtree
+    // is contiguous and in post-order, a node's right child (or its operand) is the node right before it and
+    // its left subtree ends right before the right one starts. starts[i] is where the subtree of node i starts.
+    u8 *strings = data + strings_offset;
+    Ast_Index *starts = (Ast_Index *)malloc(count * sizeof(Ast_Index));
+    assert(starts);
+
+    bool valid = tree->kinds[0] == AST_NONE;
+    for (s64 i = 1; i < count && valid; ++i) {
+        Ast_Kind kind = tree->kinds[i];
+        Ast_Payload *payload = &tree->payloads[i];
+        starts[i] = (Ast_Index)i;
+
+        if (kind == AST_NONE || kind >= AST_KIND_COUNT) { valid = false; }
+        if (ast_is_unary(kind)) {
+            Ast_Index operand = payload->unary.operand;
+            valid = valid && operand == i - 1 && tree->kinds[operand] != AST_BRANCHES;
+            if (valid) { starts[i] = starts[operand]; }
+        }
+        if (ast_has_two_children(kind)) {
+            Ast_Index left  = payload->binary.left;
+            Ast_Index right = payload->binary.right;
+            valid = valid && right == i - 1 && starts[right] > 1 && left == starts[right] - 1;
+            valid = valid && tree->kinds[left] != AST_BRANCHES;
+            valid = valid && (tree->kinds[right] == AST_BRANCHES) == (kind == AST_CONDITIONAL);
+            if (valid) { starts[i] = starts[left]; }
+        }
+        if (kind == AST_STRING) {
+            valid = valid && (u64)payload->string.offset + payload->string.count < header.strings_count;
+        }
+        if (kind == AST_IDENTIFIER) {
+            u32 name = payload->identifier.name;
+            valid = valid && name < header.strings_count && memchr(strings + name, 0, header.strings_count - name);
+        }
+    }
+    free(starts);
+
+    if (!valid) {
+        ast_tree_reset(tree);
+        return false;
+    }
+
+    if (header.strings_count) {
+        tree->strings = (char *)malloc(header.strings_count);
+        assert(tree->strings);
+        memcpy(tree->strings, strings, header.strings_count);
+        tree->strings_count    = header.strings_count;
+        tree->strings_capacity = header.strings_count;
     }
-    return NULL;
+    return true;
 }
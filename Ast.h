@@ -1,40 +1,113 @@
 #pragma once
 
 #include "Types.h"
+#include "Interner.h"
 
-/* There are 3 major types of nodes. These are the following ... 
-   1) Expressions 
-   2) Statements 
-   3) Declarations
-*/
+/**
+   The AST is stored flat. Every node of a tree lives in one Ast_Tree and is referred to by its 32 bit
+   index instead of a pointer. The kind of each node is a byte in its own dense array and everything else
+   about the node fits in an 8 byte payload, so a node costs 9 bytes and a pass which only needs the kinds
+   walks a cache line of nothing but kinds.
 
-struct Ast; 
+   Nodes are appended in post-order: children always come before their parent and the root is the last
+   node. That makes most passes a single forward sweep over the arrays, the values of a node's children
+   have always been worked out by the time we get to it. A subtree is a contiguous range of nodes ending
+   at its root.
 
-enum Ast_Type : u16 {
-    AST_EXPRESSION,
-    AST_STATEMENT,
-    AST_DECLARATION,
-};
+   Operators are part of the kind (AST_ADD rather than a binary node with an operator field). Strings,
+   including identifier names, are copied into the tree's string pool and referred to by offset, so a tree
+   holds no pointers at all and ast_serialize is a copy of the arrays.
 
-struct Ast { 
-    Ast_Type ast_type;
-};
+   A conditional has three children but a payload only has room for two indices, so it points at the
+   condition and at an AST_BRANCHES node which holds the two branches.
 
-struct Ast_Expression : public Ast { 
-    
-};
+   Index 0 is never a real node, AST_NULL can stand for "no node".
+**/
+
+typedef u32 Ast_Index;
+
+const Ast_Index AST_NULL = 0;
+
+enum Ast_Kind : u8 {
+    AST_NONE,
 
-struct Ast_Statement : public Ast { 
+    // Leaves
+    AST_INT,
+    AST_FLOAT,
+    AST_BOOL,
+    AST_STRING,
+    AST_IDENTIFIER,
+
+    // Unary
+    AST_NEGATE,
+    AST_PLUS,
+
+    // Binary
+    AST_ADD,
+    AST_SUBTRACT,
+    AST_MULTIPLY,
+    AST_DIVIDE,
+    AST_MODULO,
+
+    // condition ? then : else is AST_CONDITIONAL(condition, AST_BRANCHES(then, else)).
+    AST_BRANCHES,
+    AST_CONDITIONAL,
+
+    AST_KIND_COUNT,
 };
 
-struct Ast_Declaration : public Ast { 
+inline bool ast_is_unary(Ast_Kind kind)  { return kind >= AST_NEGATE && kind <= AST_PLUS; }
+inline bool ast_is_binary(Ast_Kind kind) { return kind >= AST_ADD && kind <= AST_MODULO; }
 
-}; 
+// Nodes whose payload is two child indices (binary.left and binary.right).
+inline bool ast_has_two_children(Ast_Kind kind) { return kind >= AST_ADD && kind <= AST_CONDITIONAL; }
 
-struct Ast_Literal : public Ast_Expression { 
-    char *string_value;
-    u64 string_count;
-    
+union Ast_Payload {
+    u64 integer_value;  // Also AST_BOOL, 0 or 1.
     f64 float_value;
-    u64 integer_value;
+    struct { u32 offset; u32 count; } string;     // Into the string pool.
+    struct { Atom atom; u32 name; } identifier;   // name is the offset of the nul terminated name in the string pool.
+    struct { Ast_Index operand; } unary;
+    struct { Ast_Index left; Ast_Index right; } binary;
 };
+
+static_assert(sizeof(Ast_Payload) == 8, "Ast_Payload should stay 8 bytes");
+
+struct Ast_Tree {
+    s64 count;     // Nodes including the AST_NULL one at index 0.
+    s64 capacity;
+
+    Ast_Kind    *kinds;
+    Ast_Payload *payloads;
+
+    char *strings;
+    s64 strings_count;
+    s64 strings_capacity;
+};
+
+void ast_tree_init(Ast_Tree *tree, s64 capacity=0);
+void ast_tree_deinit(Ast_Tree *tree);
+void ast_tree_reset(Ast_Tree *tree);
+
+Ast_Index ast_add(Ast_Tree *tree, Ast_Kind kind, Ast_Payload payload);
+Ast_Index ast_add_int(Ast_Tree *tree, u64 value);
+Ast_Index ast_add_float(Ast_Tree *tree, f64 value);
+Ast_Index ast_add_bool(Ast_Tree *tree, bool value);
+Ast_Index ast_add_string(Ast_Tree *tree, char *data, s64 count);
+Ast_Index ast_add_identifier(Ast_Tree *tree, Atom atom, char *name, s64 count);
+Ast_Index ast_add_unary(Ast_Tree *tree, Ast_Kind kind, Ast_Index operand);
+Ast_Index ast_add_binary(Ast_Tree *tree, Ast_Kind kind, Ast_Index left, Ast_Index right);
+Ast_Index ast_add_conditional(Ast_Tree *tree, Ast_Index condition, Ast_Index then, Ast_Index otherwise);
+
+inline char *ast_string(Ast_Tree *tree, u32 offset) { return tree->strings + offset; }
+
+// The first node of the subtree rooted at root.
+Ast_Index ast_subtree_start(Ast_Tree *tree, Ast_Index root);
+
+// Evaluates the subtree at root in f64. Every identifier must have a value in variables, indexed by its atom.
+// Booleans are 1 and 0, a condition is true when it isn't 0.
+f64 ast_evaluate(Ast_Tree *tree, Ast_Index root, f64 *variables=NULL, s64 variable_count=0);
+
+// The tree as one block of bytes which ast_deserialize turns back into an equal tree. Free the block with free.
+s64  ast_serialize(Ast_Tree *tree, void **data_return);
+bool ast_deserialize(Ast_Tree *tree, void *data, s64 size);
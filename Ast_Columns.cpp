@@ -0,0 +1,375 @@
+#include "Ast_Columns.h"
+
+#include <assert.h>
+#include <math.h>   // fmod
+#include <stdio.h>
+#include <stdlib.h> // malloc
+#include <string.h> // memcmp
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define COLUMN_SIMD 1
+#include <immintrin.h>
+#endif
+
+const s32 COLUMN_NO_SLOT = -1;
+
+struct Column_Compiler {
+    Column_Program *program;
+    Ast_Tree *tree;
+
+    // Scratch slot used for each depth, allocated the first time that depth is reached.
+    s32 *depth_slots;
+    s32 depth_capacity;
+
+    bool failed;
+};
+
+static s32 add_slot(Column_Program *program, Column_Slot slot) {
+    if (program->slot_count >= program->slot_capacity) {
+        s32 capacity = program->slot_capacity * 2;
+        if (capacity < 16) { capacity = 16; }
+        program->slots = (Column_Slot *)realloc(program->slots, capacity * sizeof(Column_Slot));
+        assert(program->slots);
+        program->slot_capacity = capacity;
+    }
+
+    if (slot.kind == COLUMN_SLOT_SCRATCH || slot.kind == COLUMN_SLOT_CONSTANT) { ++program->scratch_count; }
+
+    program->slots[program->slot_count] = slot;
+    return program->slot_count++;
+}
+
+static void add_step(Column_Program *program, Column_Op op, s32 destination, s32 a, s32 b=0, s32 c=0) {
+    if (program->step_count >= program->step_capacity) {
+        s32 capacity = program->step_capacity * 2;
+        if (capacity < 32) { capacity = 32; }
+        program->steps = (Column_Step *)realloc(program->steps, capacity * sizeof(Column_Step));
+        assert(program->steps);
+        program->step_capacity = capacity;
+    }
+
+    Column_Step *step  = &program->steps[program->step_count++];
+    step->op           = op;
+    step->destination  = destination;
+    step->a            = a;
+    step->b            = b;
+    step->c            = c;
+}
+
+static s32 scratch_slot(Column_Compiler *compiler, s32 depth) {
+    if (depth >= compiler->depth_capacity) {
+        s32 capacity = compiler->depth_capacity * 2;
+        if (capacity < 16)       { capacity = 16; }
+        if (capacity < depth + 1) { capacity = depth + 1; }
+        compiler->depth_slots = (s32 *)realloc(compiler->depth_slots, capacity * sizeof(s32));
+        assert(compiler->depth_slots);
+        for (s32 i = compiler->depth_capacity; i < capacity; ++i) { compiler->depth_slots[i] = COLUMN_NO_SLOT; }
+        compiler->depth_capacity = capacity;
+    }
+
+    if (compiler->depth_slots[depth] == COLUMN_NO_SLOT) {
+        Column_Slot slot = {};
+        slot.kind = COLUMN_SLOT_SCRATCH;
+        compiler->depth_slots[depth] = add_slot(compiler->program, slot);
+    }
+    return compiler->depth_slots[depth];
+}
+
+static s32 constant_slot(Column_Program *program, f64 value) {
+    for (s32 i = 0; i < program->slot_count; ++i) {
+        Column_Slot *slot = &program->slots[i];
+        // memcmp so -0.0 and 0.0 (and NaNs) stay apart.
+        if (slot->kind == COLUMN_SLOT_CONSTANT && memcmp(&slot->constant, &value, sizeof(f64)) == 0) { return i; }
+    }
+
+    Column_Slot slot = {};
+    slot.kind     = COLUMN_SLOT_CONSTANT;
+    slot.constant = value;
+    return add_slot(program, slot);
+}
+
+static s32 variable_slot(Column_Program *program, Atom atom) {
+    for (s32 i = 0; i < program->slot_count; ++i) {
+        Column_Slot *slot = &program->slots[i];
+        if (slot->kind == COLUMN_SLOT_VARIABLE && slot->atom == atom) { return i; }
+    }
+
+    if (atom + 1 > program->variable_count) { program->variable_count = atom + 1; }
+
+    Column_Slot slot = {};
+    slot.kind = COLUMN_SLOT_VARIABLE;
+    slot.atom = atom;
+    return add_slot(program, slot);
+}
+
+// Returns the slot holding the node's values. Literals and variables have slots of their own and cost no
+// step, everything else goes in the scratch slot for depth.
+static s32 compile_node(Column_Compiler *compiler, Ast_Index index, s32 depth) {
+    Column_Program *program = compiler->program;
+    Ast_Tree *tree = compiler->tree;
+    Ast_Kind kind = tree->kinds[index];
+    Ast_Payload *payload = &tree->payloads[index];
+
+    switch (kind) {
+        case AST_INT:
+        case AST_BOOL:       return constant_slot(program, (f64)payload->integer_value);
+        case AST_FLOAT:      return constant_slot(program, payload->float_value);
+        case AST_IDENTIFIER: return variable_slot(program, payload->identifier.atom);
+
+        case AST_PLUS: return compile_node(compiler, payload->unary.operand, depth);
+        case AST_NEGATE: {
+            s32 operand = compile_node(compiler, payload->unary.operand, depth);
+            s32 destination = scratch_slot(compiler, depth);
+            add_step(program, COLUMN_NEGATE, destination, operand);
+            return destination;
+        }
+
+        case AST_ADD:
+        case AST_SUBTRACT:
+        case AST_MULTIPLY:
+        case AST_DIVIDE:
+        case AST_MODULO: {
+            s32 destination = scratch_slot(compiler, depth);
+            s32 left  = compile_node(compiler, payload->binary.left, depth);
+            // If the left side didn't need this depth's slot the right side can have it.
+            s32 right = compile_node(compiler, payload->binary.right, left == destination ? depth + 1 : depth);
+
+            Column_Op op = (Column_Op)(COLUMN_ADD + (kind - AST_ADD));
+            add_step(program, op, destination, left, right);
+            return destination;
+        }
+
+        case AST_CONDITIONAL: {
+            Ast_Payload *branches = &tree->payloads[payload->binary.right];
+
+            s32 destination = scratch_slot(compiler, depth);
+            s32 free_depth  = depth;
+
+            s32 condition = compile_node(compiler, payload->binary.left, free_depth);
+            if (condition == scratch_slot(compiler, free_depth)) { ++free_depth; }
+
+            s32 then = compile_node(compiler, branches->binary.left, free_depth);
+            if (then == scratch_slot(compiler, free_depth)) { ++free_depth; }
+
+            s32 otherwise = compile_node(compiler, branches->binary.right, free_depth);
+
+            add_step(program, COLUMN_SELECT, destination, condition, then, otherwise);
+            return destination;
+        }
+
+        default: break;
+    }
+
+    // Strings and anything we don't know about.
+    compiler->failed = true;
+    return 0;
+}
+
+bool column_compile(Column_Program *program, Ast_Tree *tree, Ast_Index root) {
+    assert(program && tree && root != AST_NULL && root < tree->count);
+    *program = {};
+
+    Column_Compiler compiler = {};
+    compiler.program = program;
+    compiler.tree    = tree;
+
+    s32 value = compile_node(&compiler, root, 0);
+    free(compiler.depth_slots);
+
+    if (compiler.failed) {
+        column_deinit(program);
+        return false;
+    }
+
+    Column_Slot slot = {};
+    slot.kind = COLUMN_SLOT_RESULT;
+    s32 result = add_slot(program, slot);
+
+    // The last step is the only one writing the root's value, it can write it straight into the results.
+    // A literal or variable at the root has no step so we copy it.
+    if (program->step_count && program->steps[program->step_count - 1].destination == (u32)value) {
+        program->steps[program->step_count - 1].destination = result;
+    } else {
+        add_step(program, COLUMN_COPY, result, value);
+    }
+
+    return true;
+}
+
+void column_deinit(Column_Program *program) {
+    assert(program);
+    free(program->steps);
+    free(program->slots);
+    *program = {};
+}
+
+/**
+   Kernels, each of them runs one op over count values. Ops with fewer than three operands get a for the
+   ones they don't use. destination can be the same column as any of the inputs (never partly overlapping
+   one), every value is read before it is written over.
+**/
+
+typedef void (*Column_Kernel)(f64 *destination, const f64 *a, const f64 *b, const f64 *c, s64 count);
+
+#define COLUMN_SCALAR_KERNEL(name, expression)                                                      \
+    static void name(f64 *destination, const f64 *a, const f64 *b, const f64 *c, s64 count) {     \
+        (void)a; (void)b; (void)c;                                                                  \
+        for (s64 i = 0; i < count; ++i) { destination[i] = (expression); }                         \
+    }
+
+COLUMN_SCALAR_KERNEL(column_copy_scalar,     a[i])
+COLUMN_SCALAR_KERNEL(column_negate_scalar,   -a[i])
+COLUMN_SCALAR_KERNEL(column_add_scalar,      a[i] + b[i])
+COLUMN_SCALAR_KERNEL(column_subtract_scalar, a[i] - b[i])
+COLUMN_SCALAR_KERNEL(column_multiply_scalar, a[i] * b[i])
+COLUMN_SCALAR_KERNEL(column_divide_scalar,   a[i] / b[i])
+COLUMN_SCALAR_KERNEL(column_modulo_scalar,   fmod(a[i], b[i]))
+COLUMN_SCALAR_KERNEL(column_select_scalar,   a[i] != 0 ? b[i] : c[i])
+
+// @Sync: Must be in Column_Op order.
+static const Column_Kernel column_kernels_scalar[] = {
+    column_copy_scalar, column_negate_scalar, column_add_scalar, column_subtract_scalar,
+    column_multiply_scalar, column_divide_scalar, column_modulo_scalar, column_select_scalar,
+};
+static_assert(sizeof(column_kernels_scalar) / sizeof(column_kernels_scalar[0]) == COLUMN_OP_COUNT, "Kernels and Column_Op are out of sync");
+
+#if COLUMN_SIMD
+
+// Vector kernels do 2 (SSE2) or 4 (AVX) rows per step, the scalar kernel does whatever is left over.
+// There's no fmod instruction so % always uses the scalar kernel.
+
+#define COLUMN_SSE2_KERNEL(name, scalar, expression)                                                \
+    static void name(f64 *destination, const f64 *a, const f64 *b, const f64 *c, s64 count) {     \
+        s64 i = 0;                                                                                  \
+        for (; i + 2 <= count; i += 2) {                                                            \
+            __m128d va = _mm_loadu_pd(a + i);                                                       \
+            __m128d vb = _mm_loadu_pd(b + i);                                                           \
+            __m128d vc = _mm_loadu_pd(c + i);                                                           \
+            (void)vb; (void)vc;                                                                     \
+            _mm_storeu_pd(destination + i, (expression));                                           \
+        }                                                                                           \
+        scalar(destination + i, a + i, b + i, c + i, count - i);                                      \
+    }
+
+// cmpneq is true for NaN, same as != in C.
+COLUMN_SSE2_KERNEL(column_copy_sse2,     column_copy_scalar,     va)
+COLUMN_SSE2_KERNEL(column_negate_sse2,   column_negate_scalar,   _mm_xor_pd(va, _mm_set1_pd(-0.0)))
+COLUMN_SSE2_KERNEL(column_add_sse2,      column_add_scalar,      _mm_add_pd(va, vb))
+COLUMN_SSE2_KERNEL(column_subtract_sse2, column_subtract_scalar, _mm_sub_pd(va, vb))
+COLUMN_SSE2_KERNEL(column_multiply_sse2, column_multiply_scalar, _mm_mul_pd(va, vb))
+COLUMN_SSE2_KERNEL(column_divide_sse2,   column_divide_scalar,   _mm_div_pd(va, vb))
+COLUMN_SSE2_KERNEL(column_select_sse2,   column_select_scalar,
+                   _mm_or_pd(_mm_and_pd(_mm_cmpneq_pd(va, _mm_setzero_pd()), vb),
+                             _mm_andnot_pd(_mm_cmpneq_pd(va, _mm_setzero_pd()), vc)))
+
+static const Column_Kernel column_kernels_sse2[] = {
+    column_copy_sse2, column_negate_sse2, column_add_sse2, column_subtract_sse2,
+    column_multiply_sse2, column_divide_sse2, column_modulo_scalar, column_select_sse2,
+};
+static_assert(sizeof(column_kernels_sse2) / sizeof(column_kernels_sse2[0]) == COLUMN_OP_COUNT, "Kernels and Column_Op are out of sync");
+
+#define AVX_TARGET __attribute__((target("avx")))
+
+#define COLUMN_AVX_KERNEL(name, scalar, expression)                                                 \
+    AVX_TARGET static void name(f64 *destination, const f64 *a, const f64 *b, const f64 *c, s64 count) { \
+        s64 i = 0;                                                                                  \
+        for (; i + 4 <= count; i += 4) {                                                            \
+            __m256d va = _mm256_loadu_pd(a + i);                                                    \
+            __m256d vb = _mm256_loadu_pd(b + i);                                                        \
+            __m256d vc = _mm256_loadu_pd(c + i);                                                        \
+            (void)vb; (void)vc;                                                                     \
+            _mm256_storeu_pd(destination + i, (expression));                                        \
+        }                                                                                           \
+        scalar(destination + i, a + i, b + i, c + i, count - i);                                      \
+    }
+
+// _CMP_NEQ_UQ is the unordered version, true for NaN like cmpneq above.
+COLUMN_AVX_KERNEL(column_copy_avx,     column_copy_scalar,     va)
+COLUMN_AVX_KERNEL(column_negate_avx,   column_negate_scalar,   _mm256_xor_pd(va, _mm256_set1_pd(-0.0)))
+COLUMN_AVX_KERNEL(column_add_avx,      column_add_scalar,      _mm256_add_pd(va, vb))
+COLUMN_AVX_KERNEL(column_subtract_avx, column_subtract_scalar, _mm256_sub_pd(va, vb))
+COLUMN_AVX_KERNEL(column_multiply_avx, column_multiply_scalar, _mm256_mul_pd(va, vb))
+COLUMN_AVX_KERNEL(column_divide_avx,   column_divide_scalar,   _mm256_div_pd(va, vb))
+COLUMN_AVX_KERNEL(column_select_avx,   column_select_scalar,
+                  _mm256_blendv_pd(vc, vb, _mm256_cmp_pd(va, _mm256_setzero_pd(), _CMP_NEQ_UQ)))
+
+static const Column_Kernel column_kernels_avx[] = {
+    column_copy_avx, column_negate_avx, column_add_avx, column_subtract_avx,
+    column_multiply_avx, column_divide_avx, column_modulo_scalar, column_select_avx,
+};
+static_assert(sizeof(column_kernels_avx) / sizeof(column_kernels_avx[0]) == COLUMN_OP_COUNT, "Kernels and Column_Op are out of sync");
+
+#endif // COLUMN_SIMD
+
+static const Column_Kernel *select_column_kernels() {
+#if COLUMN_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) { return column_kernels_avx; }
+    return column_kernels_sse2;
+#else
+    return column_kernels_scalar;
+#endif
+}
+
+static const Column_Kernel *selected_column_kernels = select_column_kernels();
+
+void column_run(Column_Program *program, const f64 *const *columns, s64 column_count, s64 row_count, f64 *results) {
+    assert(program && program->slots && results);
+
+    for (s32 i = 0; i < program->slot_count; ++i) {
+        Column_Slot *slot = &program->slots[i];
+        if (slot->kind != COLUMN_SLOT_VARIABLE) { continue; }
+        if (slot->atom >= column_count || !columns[slot->atom]) {
+            printf("No column for variable %u\n", slot->atom);
+            exit(1);
+        }
+    }
+
+    // Where each slot's values are for the current chunk.
+    f64 *small_pointers[32];
+    f64 **pointers = small_pointers;
+    if (program->slot_count > 32) {
+        pointers = (f64 **)malloc(program->slot_count * sizeof(f64 *));
+        assert(pointers);
+    }
+
+    f64 *scratch = (f64 *)malloc(program->scratch_count * COLUMN_CHUNK_ROWS * sizeof(f64));
+    assert(scratch || !program->scratch_count);
+
+    f64 *cursor = scratch;
+    for (s32 i = 0; i < program->slot_count; ++i) {
+        Column_Slot *slot = &program->slots[i];
+        if (slot->kind == COLUMN_SLOT_SCRATCH || slot->kind == COLUMN_SLOT_CONSTANT) {
+            pointers[i] = cursor;
+            cursor += COLUMN_CHUNK_ROWS;
+        }
+        if (slot->kind == COLUMN_SLOT_CONSTANT) {
+            for (s64 row = 0; row < COLUMN_CHUNK_ROWS; ++row) { pointers[i][row] = slot->constant; }
+        }
+    }
+
+    const Column_Kernel *kernels = selected_column_kernels;
+
+    for (s64 row = 0; row < row_count; row += COLUMN_CHUNK_ROWS) {
+        s64 count = row_count - row;
+        if (count > COLUMN_CHUNK_ROWS) { count = COLUMN_CHUNK_ROWS; }
+
+        for (s32 i = 0; i < program->slot_count; ++i) {
+            Column_Slot *slot = &program->slots[i];
+            // Kernels never write to variable slots, casting away const is fine.
+            if (slot->kind == COLUMN_SLOT_VARIABLE) { pointers[i] = (f64 *)columns[slot->atom] + row; }
+            if (slot->kind == COLUMN_SLOT_RESULT)   { pointers[i] = results + row; }
+        }
+
+        for (s32 i = 0; i < program->step_count; ++i) {
+            Column_Step *step = &program->steps[i];
+            const f64 *a = pointers[step->a];
+            const f64 *b = step->op >= COLUMN_ADD    ? pointers[step->b] : a;
+            const f64 *c = step->op == COLUMN_SELECT ? pointers[step->c] : a;
+            kernels[step->op](pointers[step->destination], a, b, c, count);
+        }
+    }
+
+    free(scratch);
+    if (pointers != small_pointers) { free(pointers); }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Types.h"
+#include "Ast.h"
+
+/**
+   Evaluates one expression over whole columns of inputs, for when the same formula runs over many rows.
+
+   Instead of going over the tree once per row, every operator runs once over a chunk of COLUMN_CHUNK_ROWS
+   rows with a vectorized kernel (AVX or SSE2, picked once at startup, with a scalar fallback), so the
+   per-row cost is a few instructions per operator. Each node's values for the chunk go in a scratch
+   column picked by its depth like the bytecode VM does with registers, so the scratch columns of a chunk
+   stay in L1. Variables are read straight from the input columns and the root writes straight into the
+   results.
+
+   The results are exactly what ast_evaluate gives for each row: everything is done in f64, % is fmod and
+   a conditional picks a branch where the condition is != 0. Like ast_evaluate both branches are worked
+   out and the one not taken is thrown away.
+
+   A compiled program is only read by column_run, so any number of threads can run it at once (on
+   different rows, say).
+**/
+
+const s64 COLUMN_CHUNK_ROWS = 256;
+
+enum Column_Op : u8 {
+    COLUMN_COPY,      // destination = a
+    COLUMN_NEGATE,    // destination = -a
+    COLUMN_ADD,       // destination = a + b
+    COLUMN_SUBTRACT,
+    COLUMN_MULTIPLY,
+    COLUMN_DIVIDE,
+    COLUMN_MODULO,
+    COLUMN_SELECT,    // destination = a != 0 ? b : c
+
+    COLUMN_OP_COUNT,
+};
+
+// Operands are slot numbers, see Column_Slot_Kind.
+struct Column_Step {
+    Column_Op op;
+    u32 destination;
+    u32 a;
+    u32 b;
+    u32 c;
+};
+
+enum Column_Slot_Kind : u8 {
+    COLUMN_SLOT_SCRATCH,   // A chunk of intermediate values.
+    COLUMN_SLOT_CONSTANT,  // A chunk filled with a literal.
+    COLUMN_SLOT_VARIABLE,  // The current chunk of an input column.
+    COLUMN_SLOT_RESULT,    // The current chunk of the results.
+};
+
+struct Column_Slot {
+    Column_Slot_Kind kind;
+    union {
+        f64 constant;
+        Atom atom;
+    };
+};
+
+struct Column_Program {
+    Column_Step *steps;
+    s32 step_count;
+    s32 step_capacity;
+
+    Column_Slot *slots;
+    s32 slot_count;
+    s32 slot_capacity;
+
+    s32 scratch_count;    // Slots needing a chunk of memory of their own, scratch and constants.
+    s64 variable_count;   // columns passed to column_run must have at least this many entries.
+};
+
+// Returns false for trees with strings in them. program is initialized either way.
+bool column_compile(Column_Program *program, Ast_Tree *tree, Ast_Index root);
+void column_deinit(Column_Program *program);
+
+// results[row] = the expression with every variable set to columns[atom][row], for row in [0, row_count).
+// columns only needs entries for the atoms the expression uses, the others can be NULL.
+void column_run(Column_Program *program, const f64 *const *columns, s64 column_count, s64 row_count, f64 *results);
@@ -0,0 +1,197 @@
+#include "Ast_Fold.h"
+
+#include <assert.h>
+#include <math.h>   // fmod, signbit
+#include <stdlib.h> // malloc
+
+static bool is_literal(Ast_Kind kind) {
+    return kind == AST_INT || kind == AST_FLOAT || kind == AST_BOOL;
+}
+
+static f64 literal_value(Ast_Tree *tree, Ast_Index index) {
+    if (tree->kinds[index] == AST_FLOAT) { return tree->payloads[index].float_value; }
+    return (f64)tree->payloads[index].integer_value;
+}
+
+static bool is_literal_equal_to(Ast_Tree *tree, Ast_Index index, f64 value) {
+    return is_literal(tree->kinds[index]) && literal_value(tree, index) == value;
+}
+
+// Turns node into a literal with the given value. AST_INT when that's exact, so the tree still evaluates
+// to the same f64.
+static void set_number(Ast_Tree *tree, Ast_Index index, f64 value) {
+    if (value >= 0 && value <= 9007199254740992.0 && value == (f64)(u64)value && !signbit(value)) {
+        tree->kinds[index] = AST_INT;
+        tree->payloads[index].integer_value = (u64)value;
+    } else {
+        tree->kinds[index] = AST_FLOAT;
+        tree->payloads[index].float_value = value;
+    }
+}
+
+// Replaces node with a copy of one of its descendants. The copy's children still come before it.
+static void replace_with(Ast_Tree *tree, Ast_Index index, Ast_Index descendant) {
+    tree->kinds[index]    = tree->kinds[descendant];
+    tree->payloads[index] = tree->payloads[descendant];
+}
+
+static f64 fold_binary(Ast_Kind kind, f64 left, f64 right) {
+    switch (kind) {
+        case AST_ADD:      return left + right;
+        case AST_SUBTRACT: return left - right;
+        case AST_MULTIPLY: return left * right;
+        case AST_DIVIDE:   return left / right;
+        case AST_MODULO:   return fmod(left, right);
+        default: break;
+    }
+    assert(!"Not a binary operator");
+    return 0;
+}
+
+// Simplifies node index, whose children have already been simplified. Returns true if it changed.
+static bool fold_node(Ast_Tree *tree, Ast_Index index) {
+    Ast_Kind kind = tree->kinds[index];
+    Ast_Payload payload = tree->payloads[index];
+
+    if (ast_is_unary(kind)) {
+        Ast_Index operand = payload.unary.operand;
+        if (kind == AST_PLUS) {
+            replace_with(tree, index, operand);
+            return true;
+        }
+        if (is_literal(tree->kinds[operand])) {
+            set_number(tree, index, -literal_value(tree, operand));
+            return true;
+        }
+        return false;
+    }
+
+    if (ast_is_binary(kind)) {
+        Ast_Index left  = payload.binary.left;
+        Ast_Index right = payload.binary.right;
+
+        if (is_literal(tree->kinds[left]) && is_literal(tree->kinds[right])) {
+            set_number(tree, index, fold_binary(kind, literal_value(tree, left), literal_value(tree, right)));
+            return true;
+        }
+
+        Ast_Index keep = AST_NULL;
+        switch (kind) {
+            case AST_MULTIPLY: {
+                if (is_literal_equal_to(tree, right, 1)) { keep = left; }
+                else if (is_literal_equal_to(tree, left, 1)) { keep = right; }
+            } break;
+            case AST_ADD: {
+                if (is_literal_equal_to(tree, right, 0)) { keep = left; }
+                else if (is_literal_equal_to(tree, left, 0)) { keep = right; }
+            } break;
+            case AST_SUBTRACT: {
+                if (is_literal_equal_to(tree, right, 0)) { keep = left; }
+            } break;
+            case AST_DIVIDE: {
+                if (is_literal_equal_to(tree, right, 1)) { keep = left; }
+            } break;
+            default: break;
+        }
+
+        if (keep == AST_NULL) { return false; }
+        replace_with(tree, index, keep);
+        return true;
+    }
+
+    if (kind == AST_CONDITIONAL) {
+        Ast_Index condition = payload.binary.left;
+        if (!is_literal(tree->kinds[condition])) { return false; }
+
+        Ast_Payload branches = tree->payloads[payload.binary.right];
+        replace_with(tree, index, literal_value(tree, condition) != 0 ? branches.binary.left : branches.binary.right);
+        return true;
+    }
+
+    return false;
+}
+
+static Ast_Index remap_child(Ast_Index child, Ast_Index start, Ast_Index root, Ast_Index *remap, s64 removed) {
+    if (child < start) { return child; }
+    if (child > root)  { return (Ast_Index)(child - removed); }
+    assert(remap[child - start] != AST_NULL);
+    return remap[child - start];
+}
+
+// Drops every node in [start, root] that root no longer reaches and moves the nodes after root down to
+// close the gap.
+static Ast_Index compact(Ast_Tree *tree, Ast_Index start, Ast_Index root) {
+    s64 count = root - start + 1;
+    Ast_Index *remap = (Ast_Index *)malloc(count * sizeof(Ast_Index)); // AST_NULL for dead nodes.
+    assert(remap);
+
+    // Walking backwards we see every parent before its children.
+    for (s64 i = 0; i < count; ++i) { remap[i] = AST_NULL; }
+    remap[root - start] = root;
+    for (Ast_Index i = root; i >= start && i != AST_NULL; --i) {
+        if (remap[i - start] == AST_NULL) { continue; }
+
+        Ast_Kind kind = tree->kinds[i];
+        Ast_Payload *payload = &tree->payloads[i];
+        if (ast_has_two_children(kind)) {
+            remap[payload->binary.left  - start] = payload->binary.left;
+            remap[payload->binary.right - start] = payload->binary.right;
+        } else if (ast_is_unary(kind)) {
+            remap[payload->unary.operand - start] = payload->unary.operand;
+        }
+    }
+
+    // Live nodes only ever move down, so this can be done in place.
+    Ast_Index next = start;
+    for (Ast_Index i = start; i <= root; ++i) {
+        if (remap[i - start] == AST_NULL) { continue; }
+
+        Ast_Kind kind = tree->kinds[i];
+        Ast_Payload payload = tree->payloads[i];
+        if (ast_has_two_children(kind)) {
+            payload.binary.left  = remap[payload.binary.left  - start];
+            payload.binary.right = remap[payload.binary.right - start];
+        } else if (ast_is_unary(kind)) {
+            payload.unary.operand = remap[payload.unary.operand - start];
+        }
+
+        tree->kinds[next]    = kind;
+        tree->payloads[next] = payload;
+        remap[i - start] = next++;
+    }
+
+    // Nodes after the subtree only refer to nodes before them, anything in the subtree has been remapped by now.
+    s64 removed = root + 1 - next;
+    for (s64 i = root + 1; i < tree->count; ++i) {
+        Ast_Kind kind = tree->kinds[i];
+        Ast_Payload payload = tree->payloads[i];
+        if (ast_has_two_children(kind)) {
+            payload.binary.left  = remap_child(payload.binary.left,  start, root, remap, removed);
+            payload.binary.right = remap_child(payload.binary.right, start, root, remap, removed);
+        } else if (ast_is_unary(kind)) {
+            payload.unary.operand = remap_child(payload.unary.operand, start, root, remap, removed);
+        }
+
+        tree->kinds[i - removed]    = kind;
+        tree->payloads[i - removed] = payload;
+    }
+
+    tree->count -= removed;
+    Ast_Index new_root = remap[root - start];
+    free(remap);
+    return new_root;
+}
+
+Ast_Index ast_fold_constants(Ast_Tree *tree, Ast_Index root) {
+    assert(tree && root != AST_NULL && root < tree->count);
+
+    Ast_Index start = ast_subtree_start(tree, root);
+
+    bool changed = false;
+    for (Ast_Index i = start; i <= root; ++i) {
+        if (fold_node(tree, i)) { changed = true; }
+    }
+
+    if (changed) { return compact(tree, start, root); }
+    return root;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Types.h"
+#include "Ast.h"
+
+/**
+   Constant folding and algebraic simplification.
+
+   Because the tree is in post-order, one forward sweep over a subtree sees every node after its children
+   have already been simplified, so folding is a single bottom-up pass over the arrays. A node which can be
+   simplified is rewritten in place, the nodes nobody refers to anymore are squeezed out afterwards and the
+   nodes after the subtree move down with the rest. Nodes which don't change keep their kind and payload.
+
+   What gets folded:
+     - operators and conditionals whose operands are all literals,
+     - x * 1, 1 * x, x / 1, x + 0, 0 + x, x - 0 and +x to x,
+     - a conditional on a literal (true, false or a number) to the branch it takes.
+
+   The folded tree evaluates to what the original did, except for the sign of zero: x + 0 turns a -0.0
+   into 0.0 but after folding it stays -0.0 (which shows if it ends up divided into something). x * 0 isn't
+   folded at all since every value is an f64 and x could be a NaN or an infinity.
+**/
+
+// Returns the root of the folded subtree. Indices of nodes after the subtree's first node may change.
+Ast_Index ast_fold_constants(Ast_Tree *tree, Ast_Index root);
@@ -0,0 +1,274 @@
+#include "Bytecode.h"
+#include "Hash_Table.h"
+
+#include <assert.h>
+#include <math.h>   // fmod
+#include <stdlib.h> // malloc
+#include <string.h> // memcpy
+
+const s64 BYTECODE_MAX_INDEX = 0xffff;
+
+/**
+   Registers are numbered with temporaries first while compiling: register r < TEMPORARY_LIMIT is temporary r,
+   anything above is constant (r - TEMPORARY_LIMIT). bytecode_compile renumbers them into the final layout
+   (constants first) in a pass over the instructions once both counts are known.
+**/
+
+const s64 TEMPORARY_LIMIT = 0x8000;
+
+struct Bytecode_Compiler {
+    Bytecode *program;
+    Ast_Tree *tree;
+
+    // Value of each constant register, they go in the register file once we know how many temporaries we need.
+    f64 *constants;
+    s32 constants_capacity;
+
+    // Bit pattern of each constant to its number, so -0.0 and 0.0 (and NaNs) stay apart.
+    Hash_Table<u64, s32> constant_numbers;
+
+    s64 temporary_count;
+    bool failed;
+};
+
+static s64 emit(Bytecode_Compiler *compiler, Bytecode_Op op, s64 destination, s64 left=0, s64 right=0) {
+    Bytecode *program = compiler->program;
+    if (program->instruction_count >= program->instruction_capacity) {
+        s32 capacity = program->instruction_capacity * 2;
+        if (capacity < 64) { capacity = 64; }
+        program->instructions = (Instruction *)realloc(program->instructions, capacity * sizeof(Instruction));
+        assert(program->instructions);
+        program->instruction_capacity = capacity;
+    }
+
+    if (program->instruction_count > BYTECODE_MAX_INDEX) { compiler->failed = true; }
+
+    Instruction *instruction = &program->instructions[program->instruction_count];
+    instruction->op          = op;
+    instruction->destination = (u16)destination;
+    instruction->left        = (u16)left;
+    instruction->right       = (u16)right;
+    return program->instruction_count++;
+}
+
+// Returns the constant's number, counting from 0. See TEMPORARY_LIMIT for how that becomes a register.
+static s64 constant_register(Bytecode_Compiler *compiler, f64 value) {
+    Bytecode *program = compiler->program;
+
+    u64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    s32 *number = table_find_pointer(&compiler->constant_numbers, bits);
+    if (number) { return *number; }
+
+    // Past this the constant registers would run into the temporaries.
+    if (program->constant_count >= TEMPORARY_LIMIT) {
+        compiler->failed = true;
+        return 0;
+    }
+
+    if (program->constant_count >= compiler->constants_capacity) {
+        s32 capacity = compiler->constants_capacity * 2;
+        if (capacity < 16) { capacity = 16; }
+        compiler->constants = (f64 *)realloc(compiler->constants, capacity * sizeof(f64));
+        assert(compiler->constants);
+        compiler->constants_capacity = capacity;
+    }
+
+    compiler->constants[program->constant_count] = value;
+    table_add(&compiler->constant_numbers, bits, program->constant_count);
+    return program->constant_count++;
+}
+
+// Compiles node so its value ends up in a register and returns that register. That's target unless the
+// node is a literal, then it's the literal's constant register.
+static s64 compile_node(Bytecode_Compiler *compiler, Ast_Index index, s64 target) {
+    Ast_Tree *tree = compiler->tree;
+    Ast_Kind kind = tree->kinds[index];
+    Ast_Payload *payload = &tree->payloads[index];
+
+    if (target >= TEMPORARY_LIMIT) { compiler->failed = true; return target; }
+    if (target + 1 > compiler->temporary_count) { compiler->temporary_count = target + 1; }
+
+    switch (kind) {
+        case AST_INT:
+        case AST_BOOL:  return TEMPORARY_LIMIT + constant_register(compiler, (f64)payload->integer_value);
+        case AST_FLOAT: return TEMPORARY_LIMIT + constant_register(compiler, payload->float_value);
+
+        case AST_IDENTIFIER: {
+            Atom atom = payload->identifier.atom;
+            if (atom > BYTECODE_MAX_INDEX) { compiler->failed = true; return target; }
+            if (atom + 1 > compiler->program->variable_count) { compiler->program->variable_count = atom + 1; }
+            emit(compiler, OP_LOAD_VARIABLE, target, atom);
+            return target;
+        }
+
+        case AST_PLUS:   return compile_node(compiler, payload->unary.operand, target);
+        case AST_NEGATE: {
+            s64 operand = compile_node(compiler, payload->unary.operand, target);
+            emit(compiler, OP_NEGATE, target, operand);
+            return target;
+        }
+
+        case AST_ADD:
+        case AST_SUBTRACT:
+        case AST_MULTIPLY:
+        case AST_DIVIDE:
+        case AST_MODULO: {
+            s64 left  = compile_node(compiler, payload->binary.left, target);
+            // If the left side didn't need target the right side can have it.
+            s64 right = compile_node(compiler, payload->binary.right, left == target ? target + 1 : target);
+
+            Bytecode_Op op = (Bytecode_Op)(OP_ADD + (kind - AST_ADD));
+            emit(compiler, op, target, left, right);
+            return target;
+        }
+
+        case AST_CONDITIONAL: {
+            Ast_Payload *branches = &tree->payloads[payload->binary.right];
+
+            s64 condition = compile_node(compiler, payload->binary.left, target);
+            s64 skip_then = emit(compiler, OP_JUMP_IF_ZERO, condition);
+
+            s64 then = compile_node(compiler, branches->binary.left, target);
+            if (then != target) { emit(compiler, OP_MOVE, target, then); }
+            s64 skip_else = emit(compiler, OP_JUMP, 0);
+
+            compiler->program->instructions[skip_then].left = (u16)compiler->program->instruction_count;
+            s64 otherwise = compile_node(compiler, branches->binary.right, target);
+            if (otherwise != target) { emit(compiler, OP_MOVE, target, otherwise); }
+
+            compiler->program->instructions[skip_else].left = (u16)compiler->program->instruction_count;
+            return target;
+        }
+
+        default: break;
+    }
+
+    // Strings and anything we don't know about.
+    compiler->failed = true;
+    return target;
+}
+
+static u16 final_register(Bytecode *program, u16 r) {
+    if (r >= TEMPORARY_LIMIT) { return (u16)(r - TEMPORARY_LIMIT); }
+    return (u16)(r + program->constant_count);
+}
+
+bool bytecode_compile(Bytecode *program, Ast_Tree *tree, Ast_Index root) {
+    assert(program && tree && root != AST_NULL && root < tree->count);
+    *program = {};
+
+    Bytecode_Compiler compiler = {};
+    compiler.program = program;
+    compiler.tree    = tree;
+    table_init(&compiler.constant_numbers);
+
+    s64 result = compile_node(&compiler, root, 0);
+    emit(&compiler, OP_RETURN, 0, result);
+
+    program->register_count = (s32)(program->constant_count + compiler.temporary_count);
+    if (program->register_count > BYTECODE_MAX_INDEX + 1) { compiler.failed = true; }
+
+    table_deinit(&compiler.constant_numbers);
+
+    if (compiler.failed) {
+        free(compiler.constants);
+        bytecode_deinit(program);
+        return false;
+    }
+
+    // Constants go first in the register file.
+    for (s32 i = 0; i < program->instruction_count; ++i) {
+        Instruction *instruction = &program->instructions[i];
+        switch (instruction->op) {
+            case OP_LOAD_VARIABLE: {
+                instruction->destination = final_register(program, instruction->destination);
+            } break;
+            case OP_JUMP: break;
+            case OP_JUMP_IF_ZERO: {
+                instruction->destination = final_register(program, instruction->destination);
+            } break;
+            case OP_RETURN: {
+                instruction->left = final_register(program, instruction->left);
+            } break;
+            default: {
+                instruction->destination = final_register(program, instruction->destination);
+                instruction->left        = final_register(program, instruction->left);
+                instruction->right       = final_register(program, instruction->right);
+            } break;
+        }
+    }
+
+    program->registers = (f64 *)malloc(program->register_count * sizeof(f64));
+    assert(program->registers);
+    for (s32 i = 0; i < program->constant_count; ++i) { program->registers[i] = compiler.constants[i]; }
+
+    free(compiler.constants);
+    return true;
+}
+
+void bytecode_deinit(Bytecode *program) {
+    assert(program);
+    free(program->instructions);
+    free(program->registers);
+    *program = {};
+}
+
+#if defined(__GNUC__)
+#define BYTECODE_COMPUTED_GOTO 1
+#endif
+
+f64 bytecode_run(Bytecode *program, f64 *variables, s64 variable_count) {
+    assert(program && program->instructions);
+    assert(variable_count >= program->variable_count);
+
+    f64 *r = program->registers;
+    Instruction *code = program->instructions;
+    Instruction *ip   = code;
+
+#if BYTECODE_COMPUTED_GOTO
+    // @Sync: Must list a label for every Bytecode_Op in order.
+    static void *labels[] = {
+        &&op_load_variable, &&op_move, &&op_negate, &&op_add, &&op_subtract, &&op_multiply,
+        &&op_divide, &&op_modulo, &&op_jump_if_zero, &&op_jump, &&op_return,
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == OP_COUNT, "labels and Bytecode_Op are out of sync");
+
+    #define DISPATCH()         goto *labels[ip->op]
+    #define OPCODE(label, op)  label:
+
+    DISPATCH();
+#else
+    #define DISPATCH()         goto dispatch
+    #define OPCODE(label, op)  case op:
+
+    dispatch:
+    switch (ip->op) {
+#endif
+
+    OPCODE(op_load_variable, OP_LOAD_VARIABLE) { r[ip->destination] = variables[ip->left];          ++ip; DISPATCH(); }
+    OPCODE(op_move,          OP_MOVE)          { r[ip->destination] = r[ip->left];                  ++ip; DISPATCH(); }
+    OPCODE(op_negate,        OP_NEGATE)        { r[ip->destination] = -r[ip->left];                 ++ip; DISPATCH(); }
+    OPCODE(op_add,           OP_ADD)           { r[ip->destination] = r[ip->left] + r[ip->right];   ++ip; DISPATCH(); }
+    OPCODE(op_subtract,      OP_SUBTRACT)      { r[ip->destination] = r[ip->left] - r[ip->right];   ++ip; DISPATCH(); }
+    OPCODE(op_multiply,      OP_MULTIPLY)      { r[ip->destination] = r[ip->left] * r[ip->right];   ++ip; DISPATCH(); }
+    OPCODE(op_divide,        OP_DIVIDE)        { r[ip->destination] = r[ip->left] / r[ip->right];   ++ip; DISPATCH(); }
+    OPCODE(op_modulo,        OP_MODULO)        { r[ip->destination] = fmod(r[ip->left], r[ip->right]); ++ip; DISPATCH(); }
+    OPCODE(op_jump_if_zero,  OP_JUMP_IF_ZERO)  {
+        if (r[ip->destination] == 0) { ip = code + ip->left; } else { ++ip; }
+        DISPATCH();
+    }
+    OPCODE(op_jump,          OP_JUMP)          { ip = code + ip->left; DISPATCH(); }
+    OPCODE(op_return,        OP_RETURN)        { return r[ip->left]; }
+
+#if !BYTECODE_COMPUTED_GOTO
+        default: break;
+    }
+#endif
+
+    #undef DISPATCH
+    #undef OPCODE
+
+    assert(!"Bad instruction");
+    return 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Types.h"
+#include "Ast.h"
+
+/**
+   Compiles an expression tree once into register bytecode which can then be run over and over with
+   different variable values, without going back to the tree.
+
+   Every value lives in a register, an f64 slot in the program's register file. Literals are put into
+   registers of their own when compiling, so instructions use them directly and nothing loads them at run
+   time. After the literals come the temporaries, each node's result goes into the lowest free one.
+   Variables are read with OP_LOAD_VARIABLE from the same variables array ast_evaluate takes (indexed by
+   atom). A conditional jumps over the branch it doesn't take.
+
+   The VM dispatches with computed goto (a jump table of label addresses, one indirect jump at the end of
+   every instruction) on gcc and clang and with a switch loop everywhere else.
+
+   bytecode_run uses the program's register file, so one program can only be run by one thread at a time.
+**/
+
+enum Bytecode_Op : u8 {
+    OP_LOAD_VARIABLE,  // destination = variables[left]
+    OP_MOVE,           // destination = left
+    OP_NEGATE,         // destination = -left
+    OP_ADD,            // destination = left + right
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_MODULO,
+    OP_JUMP_IF_ZERO,   // if (destination == 0) go to instruction left
+    OP_JUMP,           // go to instruction left
+    OP_RETURN,         // return left
+
+    OP_COUNT,
+};
+
+// Register numbers and jump targets are 16 bits so an instruction is 8 bytes.
+struct Instruction {
+    Bytecode_Op op;
+    u16 destination;
+    u16 left;
+    u16 right;
+};
+
+struct Bytecode {
+    Instruction *instructions;
+    s32 instruction_count;
+    s32 instruction_capacity;
+
+    f64 *registers;       // The literals followed by room for the temporaries.
+    s32 register_count;
+    s32 constant_count;
+
+    s64 variable_count;   // variables passed to bytecode_run must have at least this many values.
+};
+
+// Returns false for trees it can't compile (strings, more than 32768 different literals, or more than 65536
+// registers or instructions), evaluate those with ast_evaluate instead. program is initialized either way.
+bool bytecode_compile(Bytecode *program, Ast_Tree *tree, Ast_Index root);
+void bytecode_deinit(Bytecode *program);
+
+f64 bytecode_run(Bytecode *program, f64 *variables, s64 variable_count);
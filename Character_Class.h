@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Types.h"
+
+/**
+   Classification of every byte value as a set of flags, built at compile time.
+
+   One table load replaces the chains of range comparisons, so checks like "can this continue an
+   identifier" cost the same no matter how many ranges make up the class.
+**/
+
+enum Character_Class_Flags : u8 {
+    CHAR_SPACE       = 1 << 0, // ' ', \t, \n, \v, \f, \r
+    CHAR_DIGIT       = 1 << 1, // 0-9
+    CHAR_ALPHA       = 1 << 2, // a-z A-Z
+    CHAR_HEX_DIGIT   = 1 << 3, // 0-9 a-f A-F
+    CHAR_IDENT_START = 1 << 4, // Can start an identifier, a-z A-Z _
+    CHAR_IDENT       = 1 << 5, // Can continue an identifier, a-z A-Z 0-9 _
+};
+
+struct Character_Class_Table {
+    u8 flags[256];
+};
+
+constexpr Character_Class_Table make_character_class_table() {
+    Character_Class_Table table = {};
+    for (s32 c = 0; c < 256; ++c) {
+        u8 flags = 0;
+        bool digit = c >= '0' && c <= '9';
+        bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+
+        if (c == ' ' || (c >= '\t' && c <= '\r'))              { flags |= CHAR_SPACE; }
+        if (digit)                                             { flags |= CHAR_DIGIT; }
+        if (alpha)                                             { flags |= CHAR_ALPHA; }
+        if (digit || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) { flags |= CHAR_HEX_DIGIT; }
+        if (alpha || c == '_')                                 { flags |= CHAR_IDENT_START; }
+        if (alpha || digit || c == '_')                        { flags |= CHAR_IDENT; }
+
+        table.flags[c] = flags;
+    }
+    return table;
+}
+
+constexpr Character_Class_Table character_classes = make_character_class_table();
+
+inline u8 character_class(char c) {
+    return character_classes.flags[(u8)c];
+}
@@ -27,8 +27,25 @@ s64 read_file(char *file_name, void **data_return) {
     return file_size;
 }
 
+// No mapping on Windows yet, just read the file into memory. read_file already nul terminates.
+bool map_file(char *file_name, Mapped_File *file) { 
+    *file = {};
+    s64 size = read_file(file_name, &file->data);
+    if (size < 0) { return false; }
+    file->size = size;
+    return true;
+}
+
+void unmap_file(Mapped_File *file) { 
+    delete[] (u8 *)file->data;
+    *file = {};
+}
+
 #else  // Linux
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 s64 read_file(char *file_name, void **data_return) {
@@ -42,7 +59,7 @@ s64 read_file(char *file_name, void **data_return) {
 
     if (result == -1) { return -1; }
 
-    s32 length = file_stats.st_size;
+    s64 length = file_stats.st_size;
 
     // +1 for nul termination
     u8 *data = new u8[length + 1];
@@ -56,4 +73,48 @@ s64 read_file(char *file_name, void **data_return) {
 
     return length;
 }
+
+// Maps the file read only instead of copying it. The mapping is followed by at least MAPPED_FILE_PADDING
+// zero bytes so it can be treated as a nul terminated string and read a little past the end.
+//
+// We reserve an anonymous (zero filled) mapping big enough for the file plus padding and then map the file
+// over the front of it. The kernel zero fills the rest of the last page of the file, and the pages after
+// it are the anonymous zero pages.
+bool map_file(char *file_name, Mapped_File *file) { 
+    *file = {};
+
+    s32 descriptor = open(file_name, O_RDONLY);
+    if (descriptor == -1) { return false; }
+
+    struct stat file_stats;
+    if (fstat(descriptor, &file_stats) == -1) { close(descriptor); return false; }
+
+    s64 size      = file_stats.st_size;
+    s64 page_size = sysconf(_SC_PAGESIZE);
+    s64 mapped_size = (size + MAPPED_FILE_PADDING + page_size - 1) & ~(page_size - 1);
+
+    void *base = mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) { close(descriptor); return false; }
+
+    if (size > 0) { 
+        void *mapped = mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, descriptor, 0);
+        if (mapped == MAP_FAILED) { munmap(base, mapped_size); close(descriptor); return false; }
+
+        // We read the file front to back once, let the kernel read ahead aggressively.
+        madvise(base, size, MADV_SEQUENTIAL);
+    }
+
+    // The mapping keeps its own reference to the file.
+    close(descriptor);
+
+    file->data        = base;
+    file->size        = size;
+    file->mapped_size = mapped_size;
+    return true;
+}
+
+void unmap_file(Mapped_File *file) { 
+    if (file->data) { munmap(file->data, file->mapped_size); }
+    *file = {};
+}
 #endif 
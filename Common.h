@@ -2,6 +2,29 @@
 
 #include "Types.h"
 #include <assert.h>
+#include <string.h> // memcmp
+
+// A view of count bytes. Not necessarily nul terminated.
+struct String { 
+    char *data;
+    s64 count;
+};
+
+inline bool operator==(String a, String b) { 
+    return a.count == b.count && memcmp(a.data, b.data, a.count) == 0;
+}
 
 s64 read_file(char *file_name, void **data_return);
 
+// Number of zero bytes guaranteed to follow the contents of a mapped file.
+const s64 MAPPED_FILE_PADDING = 64;
+
+struct Mapped_File { 
+    void *data;
+    s64 size;         // Size of the file in bytes.
+    s64 mapped_size;  // Size of the whole mapping including the zero padding. 0 if data came from read_file.
+};
+
+bool map_file(char *file_name, Mapped_File *file);
+void unmap_file(Mapped_File *file);
+
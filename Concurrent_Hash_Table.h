@@ -0,0 +1,236 @@
+#pragma once
+
+#include "Types.h"
+#include "Hash_Table.h"
+
+#include <assert.h>
+#include <stdlib.h> // calloc
+
+#include <atomic>
+#include <mutex>
+
+/**
+
+   A Hash_Table that many threads can use at the same time, for the tables shared between files when we lex
+   and parse in parallel (interned names, global symbols).
+
+   The table is split into CONCURRENT_TABLE_SHARDS shards picked by the high bits of the hash. Every shard is
+   a linear probing table laid out like Hash_Table (hash, key, value per entry, hash 0 means VACANT), the low
+   bits of the hash pick the slot inside the shard.
+
+   Lookups never take a lock. An insert writes the key and value first and publishes the entry by storing
+   its hash with release, a lookup loads the hash with acquire before it looks at the key, so a reader either
+   sees a complete entry or a VACANT slot. Entries are never changed or moved once published.
+
+   Inserts and resizes take the shard's mutex, so threads adding to different shards don't wait on each
+   other. Growing copies the entries into a new array and swaps the shard's pointer, readers which already
+   loaded the old array keep probing it safely (it is only missing what was added after they started).
+   Old arrays are kept on a list and freed in table_deinit, they add up to less than the live ones.
+
+   There is no remove or set: values can't be changed after they are published. Use table_find_or_add to
+   insert a key exactly once when several threads may race on it.
+
+**/
+
+const s32 CONCURRENT_TABLE_SHARD_BITS = 6;
+const s32 CONCURRENT_TABLE_SHARDS     = 1 << CONCURRENT_TABLE_SHARD_BITS;
+
+template <typename Key_Type, typename Value_Type, typename Traits = Hash_Traits<Key_Type>>
+struct Concurrent_Hash_Table {
+    const int MIN_SHARD_SIZE      = 16;
+    const int LOAD_FACTOR_PERCENT = 70;
+
+    struct Entry {
+        std::atomic<u32> hash;
+        Key_Type         key;
+        Value_Type       value;
+    };
+
+    struct Slots {
+        s32    table_size; // A power of 2.
+        Slots *retired;    // Older arrays of the same shard, freed at deinit.
+        Entry *entries;
+    };
+
+    // Each shard on its own cache line so the locks of neighbouring shards don't share one.
+    struct alignas(64) Shard {
+        std::atomic<Slots *> slots;
+        std::mutex           mutex;
+        std::atomic<s32>     items; // Only changed under the mutex, atomic so table_count can read it.
+        s32                  resize_threshold;
+    };
+
+    Shard shards[CONCURRENT_TABLE_SHARDS];
+};
+
+inline u32 concurrent_table_shard(u32 hash) {
+    return hash >> (32 - CONCURRENT_TABLE_SHARD_BITS);
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline typename Concurrent_Hash_Table <Key_Type, Value_Type, Traits>::Slots *concurrent_table_new_slots(s32 table_size) {
+    typedef Concurrent_Hash_Table <Key_Type, Value_Type, Traits> Table;
+
+    auto *slots = (typename Table::Slots *)malloc(sizeof(typename Table::Slots));
+    slots->table_size = table_size;
+    slots->retired    = NULL;
+    slots->entries    = (typename Table::Entry *)calloc(table_size, sizeof(typename Table::Entry));
+    assert(slots->entries);
+    return slots;
+}
+
+// The table is not usable from other threads until this returns.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_init(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table, s64 _table_size=0) {
+    s64 shard_size = _table_size / CONCURRENT_TABLE_SHARDS;
+    if (shard_size < table->MIN_SHARD_SIZE) { shard_size = table->MIN_SHARD_SIZE; }
+    shard_size = next_power_of_two((u32)shard_size);
+
+    for (s32 i = 0; i < CONCURRENT_TABLE_SHARDS; ++i) {
+        auto *shard = &table->shards[i];
+        shard->slots.store(concurrent_table_new_slots<Key_Type, Value_Type, Traits>((s32)shard_size), std::memory_order_relaxed);
+        shard->items.store(0, std::memory_order_relaxed);
+        shard->resize_threshold = (s32)(shard_size * table->LOAD_FACTOR_PERCENT) / 100;
+    }
+}
+
+// No other thread may be using the table.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_deinit(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table) {
+    for (s32 i = 0; i < CONCURRENT_TABLE_SHARDS; ++i) {
+        auto *slots = table->shards[i].slots.load(std::memory_order_relaxed);
+        while (slots) {
+            auto *retired = slots->retired;
+            free(slots->entries);
+            free(slots);
+            slots = retired;
+        }
+        table->shards[i].slots.store(NULL, std::memory_order_relaxed);
+    }
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline s64 table_count(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table) {
+    s64 count = 0;
+    for (s32 i = 0; i < CONCURRENT_TABLE_SHARDS; ++i) { count += table->shards[i].items.load(std::memory_order_relaxed); }
+    return count;
+}
+
+// Puts an entry into slots which only the caller can write to. Publishes it last.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void concurrent_table_place(typename Concurrent_Hash_Table <Key_Type, Value_Type, Traits>::Slots *slots, u32 hash, Key_Type key, Value_Type value) {
+    u32 mask  = slots->table_size - 1;
+    u32 index = hash & mask;
+
+    while (slots->entries[index].hash.load(std::memory_order_relaxed)) { index = (index + 1) & mask; }
+
+    auto *entry  = &slots->entries[index];
+    entry->key   = key;
+    entry->value = value;
+    entry->hash.store(hash, std::memory_order_release);
+}
+
+// Called with the shard's mutex held.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void concurrent_table_expand(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table, typename Concurrent_Hash_Table <Key_Type, Value_Type, Traits>::Shard *shard) {
+    auto *old_slots = shard->slots.load(std::memory_order_relaxed);
+    auto *new_slots = concurrent_table_new_slots<Key_Type, Value_Type, Traits>(old_slots->table_size * 2);
+
+    // Entries keep their hash so moving them doesn't need to hash the keys again.
+    for (s32 i = 0; i < old_slots->table_size; ++i) {
+        auto *entry = &old_slots->entries[i];
+        u32 hash = entry->hash.load(std::memory_order_relaxed);
+        if (hash) { concurrent_table_place<Key_Type, Value_Type, Traits>(new_slots, hash, entry->key, entry->value); }
+    }
+
+    new_slots->retired = old_slots;
+    shard->resize_threshold = (new_slots->table_size * table->LOAD_FACTOR_PERCENT) / 100;
+    shard->slots.store(new_slots, std::memory_order_release);
+}
+
+// Probes for an entry with the given (already valid) hash for which matches(key) is true. Doesn't lock.
+template <typename Key_Type, typename Value_Type, typename Traits, typename Matcher>
+inline Value_Type *table_find_pointer_hashed(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table, u32 hash, Matcher matches) {
+    auto *slots = table->shards[concurrent_table_shard(hash)].slots.load(std::memory_order_acquire);
+
+    u32 mask  = slots->table_size - 1;
+    u32 index = hash & mask;
+
+    while (1) {
+        auto *entry = &slots->entries[index];
+        u32 entry_hash = entry->hash.load(std::memory_order_acquire);
+        if (!entry_hash) { return NULL; }
+
+        if (entry_hash == hash && matches(entry->key)) { return &entry->value; }
+
+        index = (index + 1) & mask;
+    }
+}
+
+// The value a returned pointer points to never changes, it stays valid until table_deinit.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline Value_Type *table_find_pointer(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type key) {
+    u32 hash = table_valid_hash(Traits::hash(key));
+    return table_find_pointer_hashed(table, hash, [&](const Key_Type &other) { return Traits::equal(other, key); });
+}
+
+// Looks up a string keyed table by a slice without building a key. Only for traits which support it.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline Value_Type *table_find_pointer(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table, char *data, s64 count) {
+    u32 hash = table_valid_hash(Traits::hash(data, count));
+    return table_find_pointer_hashed(table, hash, [&](const Key_Type &other) { return Traits::equal(other, data, count); });
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline bool table_find(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type key) {
+    return table_find_pointer(table, key) != NULL;
+}
+
+// Like Hash_Table's table_add this doesn't check whether the key is already there.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_add(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type key, Value_Type value) {
+    u32 hash   = table_valid_hash(Traits::hash(key));
+    auto *shard = &table->shards[concurrent_table_shard(hash)];
+
+    std::lock_guard<std::mutex> lock(shard->mutex);
+
+    if (shard->items.load(std::memory_order_relaxed) >= shard->resize_threshold) { concurrent_table_expand(table, shard); }
+
+    concurrent_table_place<Key_Type, Value_Type, Traits>(shard->slots.load(std::memory_order_relaxed), hash, key, value);
+    shard->items.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+
+   Returns the value for key, adding it first if it isn't in the table yet. When several threads race on the
+   same key exactly one of them adds it and they all get back the same value.
+
+   make(&key, &value) is only called when the key gets added, under the shard's mutex. It has to fill in the
+   value and may replace the key with an equal one, for example a copy that outlives the caller's buffer.
+
+**/
+
+template <typename Key_Type, typename Value_Type, typename Traits, typename Make>
+inline Value_Type table_find_or_add(Concurrent_Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type key, Make make) {
+    u32 hash    = table_valid_hash(Traits::hash(key));
+    auto equals = [&](const Key_Type &other) { return Traits::equal(other, key); };
+
+    Value_Type *found = table_find_pointer_hashed(table, hash, equals);
+    if (found) { return *found; }
+
+    auto *shard = &table->shards[concurrent_table_shard(hash)];
+    std::lock_guard<std::mutex> lock(shard->mutex);
+
+    // Somebody may have added it between the lookup and taking the lock.
+    found = table_find_pointer_hashed(table, hash, equals);
+    if (found) { return *found; }
+
+    if (shard->items.load(std::memory_order_relaxed) >= shard->resize_threshold) { concurrent_table_expand(table, shard); }
+
+    Value_Type value;
+    make(&key, &value);
+
+    concurrent_table_place<Key_Type, Value_Type, Traits>(shard->slots.load(std::memory_order_relaxed), hash, key, value);
+    shard->items.fetch_add(1, std::memory_order_relaxed);
+    return value;
+}
@@ -0,0 +1,392 @@
+#include "Document.h"
+
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h> // malloc
+#include <string.h> // memmove
+
+// Don't bother compacting small trees.
+const s64 DOCUMENT_MIN_DEAD_NODES = 4096;
+
+static void document_reserve_text(Document *document, s64 count) {
+    // One more for the nul.
+    if (count + 1 <= document->text_capacity) { return; }
+
+    s64 capacity = document->text_capacity * 2;
+    if (capacity < 256)       { capacity = 256; }
+    if (capacity < count + 1) { capacity = count + 1; }
+
+    document->text = (char *)realloc(document->text, capacity);
+    assert(document->text);
+    document->text_capacity = capacity;
+}
+
+// Points the lexer at cursor, which is on the given line and column. Tokens get their positions from there.
+static void document_point_lexer(Document *document, s64 cursor, u64 line, u64 column) {
+    Lexer *lexer = &document->lexer;
+    lexer->stream.data   = document->text;
+    lexer->stream.count  = document->text_count;
+    lexer->stream.cursor = cursor;
+    lexer->current_line_number   = line;
+    lexer->current_column_number = column;
+}
+
+static void document_point_lexer_at_token(Document *document, s64 token) {
+    Token_Location location = document->tokens.locations[token];
+    document_point_lexer(document, (s64)document->tokens.offsets[token], location.line, location.column);
+}
+
+// lexer_scan_token which doesn't exit on errors. The bytes the lexer got through before giving up become a
+// TOKEN_INVALID starting where the token (or the comment it choked on) started, and the next token starts
+// after them. That only depends on the text from the token's start on, like any other token. The reason is
+// left in lexer.error_message.
+static void document_scan_token(Document *document, Token *token) {
+    Lexer *lexer = &document->lexer;
+    s64 start = lexer->stream.cursor;
+
+    // begin_token overwrites this if the lexer gets as far as the token itself.
+    *token = {};
+    token->position.line_start   = lexer->current_line_number;
+    token->position.column_start = lexer->current_column_number;
+    token->position.offset       = start;
+
+    jmp_buf jump;
+    lexer->error_jump = &jump;
+    if (setjmp(jump)) {
+        token->type = Token_Type::TOKEN_INVALID;
+        if (lexer->stream.cursor <= token->position.offset) { lexer->stream.cursor = token->position.offset + 1; }
+        token->position.line_end   = lexer->current_line_number;
+        token->position.column_end = lexer->current_column_number;
+    } else {
+        lexer_scan_token(lexer, token);
+    }
+    lexer->error_jump = NULL;
+}
+
+static void construct_reserve(Document *document, s64 count) {
+    if (count <= document->construct_capacity) { return; }
+
+    s64 capacity = document->construct_capacity * 2;
+    if (capacity < 16)    { capacity = 16; }
+    if (capacity < count) { capacity = count; }
+
+    document->constructs = (Document_Construct *)realloc(document->constructs, capacity * sizeof(Document_Construct));
+    assert(document->constructs);
+    document->construct_capacity = capacity;
+}
+
+// Index of the first ';' or TOKEN_EOF at or after token. Expressions never contain a ';', so that's where the
+// construct starting at token ends whether it parses or not.
+static s64 find_construct_end(Token_Buffer *tokens, s64 token) {
+    while (tokens->types[token] != ';' && tokens->types[token] != Token_Type::TOKEN_EOF) { ++token; }
+    return token;
+}
+
+// Keeps the error the parser stopped at on the construct. A TOKEN_INVALID only tells the parser that there's
+// something it can't use, scanning the token again gets the lexer's reason instead.
+static void set_construct_error(Document *document, Document_Construct *construct) {
+    Parser *parser = &document->parser;
+    char *message = parser->error_message;
+
+    // The parser stays on the last token, so this is the one it was at.
+    construct->error_token = parser->token_cursor - 1;
+    if (document->tokens.types[construct->error_token] == Token_Type::TOKEN_INVALID) {
+        Token token;
+        document_point_lexer_at_token(document, construct->error_token);
+        document_scan_token(document, &token);
+        message = document->lexer.error_message;
+    }
+
+    s64 count = strlen(message);
+    construct->error_message = (char *)malloc(count + 1);
+    assert(construct->error_message);
+    memcpy(construct->error_message, message, count + 1);
+}
+
+// Parses the construct starting at first_token. On an error the construct is marked invalid and keeps the
+// error, the nodes built for it so far are counted as dead.
+static void parse_construct(Document *document, s64 first_token, Document_Construct *construct) {
+    Parser *parser = &document->parser;
+    s64 node_count = parser->tree.count;
+
+    construct->first_token   = first_token;
+    construct->error_token   = -1;
+    construct->error_message = NULL;
+
+    jmp_buf jump;
+    parser->error_jump = &jump;
+    if (setjmp(jump)) {
+        construct->end_token = find_construct_end(&document->tokens, construct->first_token);
+        construct->root      = AST_NULL;
+        construct->valid     = false;
+        document->dead_nodes += parser->tree.count - node_count;
+        set_construct_error(document, construct);
+    } else {
+        construct->root  = parser_parse_expression_at(parser, first_token, &construct->end_token);
+        construct->valid = true;
+    }
+    parser->error_jump = NULL;
+}
+
+// Parses every construct from first_token up to and including the one ending at end_token, which has to be
+// a ';' or TOKEN_EOF. Returns how many there were, they're in *constructs_return (free it).
+static s64 parse_constructs(Document *document, s64 first_token, s64 end_token, Document_Construct **constructs_return) {
+    Document_Construct *constructs = NULL;
+    s64 count    = 0;
+    s64 capacity = 0;
+
+    s64 token = first_token;
+    while (1) {
+        if (count >= capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            constructs = (Document_Construct *)realloc(constructs, capacity * sizeof(Document_Construct));
+            assert(constructs);
+        }
+
+        Document_Construct *construct = &constructs[count++];
+        parse_construct(document, token, construct);
+
+        if (construct->end_token >= end_token) { break; }
+        token = construct->end_token + 1;
+    }
+    assert(constructs[count - 1].end_token == end_token);
+
+    *constructs_return = constructs;
+    return count;
+}
+
+static s64 construct_node_count(Ast_Tree *tree, Document_Construct *construct) {
+    if (construct->root == AST_NULL) { return 0; }
+    return construct->root - ast_subtree_start(tree, construct->root) + 1;
+}
+
+// Copies the nodes of every construct into a fresh tree, leaving the dead ones behind.
+static void document_compact_tree(Document *document) {
+    Ast_Tree *old_tree = &document->parser.tree;
+
+    Ast_Tree tree;
+    ast_tree_init(&tree, old_tree->count - document->dead_nodes);
+
+    for (s64 i = 0; i < document->construct_count; ++i) {
+        Document_Construct *construct = &document->constructs[i];
+        if (construct->root == AST_NULL) { continue; }
+
+        // A construct's nodes are contiguous, every child moves by the same amount as its parent.
+        Ast_Index start = ast_subtree_start(old_tree, construct->root);
+        s64 shift = tree.count - (s64)start;
+
+        for (Ast_Index index = start; index <= construct->root; ++index) {
+            Ast_Kind kind = old_tree->kinds[index];
+            Ast_Payload payload = old_tree->payloads[index];
+
+            if (kind == AST_STRING) {
+                ast_add_string(&tree, ast_string(old_tree, payload.string.offset), payload.string.count);
+            } else if (kind == AST_IDENTIFIER) {
+                char *name = ast_string(old_tree, payload.identifier.name);
+                ast_add_identifier(&tree, payload.identifier.atom, name, strlen(name));
+            } else {
+                if (ast_has_two_children(kind)) {
+                    payload.binary.left  = (Ast_Index)(payload.binary.left  + shift);
+                    payload.binary.right = (Ast_Index)(payload.binary.right + shift);
+                } else if (ast_is_unary(kind)) {
+                    payload.unary.operand = (Ast_Index)(payload.unary.operand + shift);
+                }
+                ast_add(&tree, kind, payload);
+            }
+        }
+
+        construct->root = (Ast_Index)(construct->root + shift);
+    }
+
+    ast_tree_deinit(old_tree);
+    *old_tree = tree;
+    document->dead_nodes = 0;
+}
+
+void document_init(Document *document, char *text) {
+    assert(document && text);
+    *document = {};
+
+    document->text_count = strlen(text);
+    document_reserve_text(document, document->text_count);
+    memcpy(document->text, text, document->text_count + 1);
+
+    lexer_init(&document->lexer);
+    // Where lexer_set_input_from_memory would start.
+    document_point_lexer(document, 0, 1, 0);
+    token_buffer_init(&document->tokens, document->text_count / 4 + 16);
+    token_buffer_init(&document->relexed);
+
+    Token token;
+    do {
+        document_scan_token(document, &token);
+        token_buffer_add(&document->tokens, &token);
+    } while (token.type != Token_Type::TOKEN_EOF);
+
+    parser_init_from_tokens(&document->parser, &document->tokens);
+
+    Document_Construct *constructs;
+    s64 count = parse_constructs(document, 0, document->tokens.count - 1, &constructs);
+    construct_reserve(document, count);
+    memcpy(document->constructs, constructs, count * sizeof(Document_Construct));
+    document->construct_count = count;
+    free(constructs);
+}
+
+void document_deinit(Document *document) {
+    assert(document);
+    for (s64 i = 0; i < document->construct_count; ++i) { free(document->constructs[i].error_message); }
+    parser_deinit(&document->parser);
+    token_buffer_deinit(&document->tokens);
+    token_buffer_deinit(&document->relexed);
+    lexer_deinit(&document->lexer);
+    free(document->constructs);
+    free(document->text);
+    *document = {};
+}
+
+// Index of the first construct whose end_token is at or after token.
+static s64 find_construct(Document *document, s64 token) {
+    s64 low  = 0;
+    s64 high = document->construct_count - 1;
+    while (low < high) {
+        s64 middle = low + (high - low) / 2;
+        if (document->constructs[middle].end_token < token) { low = middle + 1; }
+        else { high = middle; }
+    }
+    return low;
+}
+
+bool document_edit(Document *document, s64 offset, s64 removed_count, char *inserted, s64 inserted_count, Document_Change *change) {
+    assert(document && (inserted || inserted_count == 0));
+    assert(offset >= 0 && removed_count >= 0 && inserted_count >= 0 && offset + removed_count <= document->text_count);
+
+    Document_Change local_change;
+    if (!change) { change = &local_change; }
+    *change = {};
+
+    // The lexer would take a nul for the end of the text and stop in the middle of it.
+    if (inserted_count && memchr(inserted, 0, inserted_count)) { return false; }
+
+    s64 delta = inserted_count - removed_count;
+
+    //
+    // Text, the tail moves along with its nul.
+    //
+    s64 tail = document->text_count - (offset + removed_count);
+    document_reserve_text(document, document->text_count + delta);
+    memmove(document->text + offset + inserted_count, document->text + offset + removed_count, tail + 1);
+    memcpy(document->text + offset, inserted, inserted_count);
+    document->text_count += delta;
+
+    //
+    // Tokens. The last token starting before the edit may run into it (or merge with what's inserted), so
+    // lexing starts there. If no token starts before the edit we start at the very beginning.
+    //
+    Token_Buffer *tokens = &document->tokens;
+
+    s64 low  = 0;
+    s64 high = tokens->count;
+    while (low < high) {
+        s64 middle = low + (high - low) / 2;
+        if ((s64)tokens->offsets[middle] < offset) { low = middle + 1; }
+        else { high = middle; }
+    }
+    s64 first_token = low > 0 ? low - 1 : 0;
+
+    // An old token past the edit starts at its offset + delta in the new text. Once a new token starts
+    // there the rest are all the same, TOKEN_EOF always matches so we always get there.
+    s64 edit_end    = offset + inserted_count;
+    s64 resync      = first_token;
+    Token_Buffer *relexed = &document->relexed;
+    relexed->count  = 0;
+
+    if (low > 0) { document_point_lexer_at_token(document, first_token); }
+    else         { document_point_lexer(document, 0, 1, 0); }
+    Token token;
+    while (1) {
+        document_scan_token(document, &token);
+        s64 start = (s64)token.position.offset;
+
+        if (start >= edit_end) {
+            while ((s64)tokens->offsets[resync] + delta < start) { ++resync; }
+            if ((s64)tokens->offsets[resync] + delta == start) { break; }
+        }
+
+        assert(token.type != Token_Type::TOKEN_EOF);
+        token_buffer_add(relexed, &token);
+    }
+
+    s64 removed_tokens = resync - first_token;
+    s64 token_shift    = relexed->count - removed_tokens;
+    change->relexed_tokens = relexed->count;
+
+    // The old tokens from resync on moved as many lines as it did, and the ones on its line as many columns.
+    Token_Location moved_from = tokens->locations[resync];
+    s64 line_shift   = (s64)token.position.line_start   - (s64)moved_from.line;
+    s64 column_shift = (s64)token.position.column_start - (s64)moved_from.column;
+
+    token_buffer_splice(tokens, first_token, removed_tokens, relexed);
+    for (s64 i = first_token + relexed->count; i < tokens->count; ++i) {
+        Token_Location *location = &tokens->locations[i];
+        if (location->line == moved_from.line) { location->column = (u32)(location->column + column_shift); }
+        location->line = (u32)(location->line + line_shift);
+        tokens->offsets[i] += delta;
+    }
+
+    if (removed_tokens == 0 && relexed->count == 0) {
+        // Only whitespace or comments changed.
+        change->first_construct = find_construct(document, first_token);
+        return true;
+    }
+
+    //
+    // Constructs. The ones holding a replaced token get parsed again, if the ';' ending the last of them
+    // was replaced the construct after it goes too since it may have merged with it.
+    //
+    s64 first_construct = find_construct(document, first_token);
+    s64 last_construct  = find_construct(document, resync - 1 > first_token ? resync - 1 : first_token);
+    if (document->constructs[last_construct].end_token < resync) { ++last_construct; }
+    assert(last_construct < document->construct_count);
+
+    s64 region_first = first_construct > 0 ? document->constructs[first_construct - 1].end_token + 1 : 0;
+    s64 region_end   = document->constructs[last_construct].end_token + token_shift;
+
+    Document_Construct *constructs;
+    s64 count   = parse_constructs(document, region_first, region_end, &constructs);
+    s64 removed = last_construct - first_construct + 1;
+
+    Ast_Tree *tree = &document->parser.tree;
+    for (s64 i = first_construct; i <= last_construct; ++i) {
+        document->dead_nodes += construct_node_count(tree, &document->constructs[i]);
+        free(document->constructs[i].error_message);
+    }
+
+    // Splice the new constructs in and move the ones after them to their new tokens.
+    construct_reserve(document, document->construct_count - removed + count);
+    memmove(document->constructs + first_construct + count, document->constructs + last_construct + 1,
+            (document->construct_count - last_construct - 1) * sizeof(Document_Construct));
+    memcpy(document->constructs + first_construct, constructs, count * sizeof(Document_Construct));
+    document->construct_count += count - removed;
+    free(constructs);
+
+    if (token_shift) {
+        for (s64 i = first_construct + count; i < document->construct_count; ++i) {
+            Document_Construct *construct = &document->constructs[i];
+            construct->first_token += token_shift;
+            construct->end_token   += token_shift;
+            if (construct->error_token >= 0) { construct->error_token += token_shift; }
+        }
+    }
+
+    change->first_construct     = first_construct;
+    change->removed_constructs  = removed;
+    change->inserted_constructs = count;
+
+    s64 live_nodes = tree->count - 1 - document->dead_nodes;
+    if (document->dead_nodes > DOCUMENT_MIN_DEAD_NODES && document->dead_nodes > live_nodes) {
+        document_compact_tree(document);
+        change->compacted = true;
+    }
+    return true;
+}
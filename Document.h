@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Types.h"
+#include "Ast.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+/**
+   A source buffer which stays lexed and parsed while it is being edited, for editor integrations which
+   would otherwise lex and parse everything again on every keystroke.
+
+   The text is a list of expressions separated by ';', each one is a construct with its own root in the
+   document's tree. An edit (offset, removed bytes, inserted bytes) is applied like this:
+
+     - Lexing restarts at the last token starting before the edit, on that token's line and column. The
+       lexer keeps no other state between tokens, so once it starts a token at the same place (shifted by
+       the edit) as an old token past the edit, every token from there on is the old one. The tokens in
+       between replace the old ones.
+     - Only the constructs holding a replaced token are parsed again, plus the next one if a ';' between
+       them was replaced. Every other construct keeps its nodes as they are.
+     - Nodes of replaced constructs stay in the tree until there are more of them than live ones, then the
+       live constructs are copied into a fresh tree.
+
+   The lexing and parsing work is proportional to the edit. Some bookkeeping still walks everything after
+   the edit: moving the text, the token arrays and the constructs up or down, and shifting the token
+   offsets and lines. That is a memmove and a few adds per token, far cheaper than lexing, but it is
+   O(size of the document).
+
+   Errors aren't printed, they stay with the constructs. The bytes the lexer gave up on become a
+   TOKEN_INVALID token and a construct which doesn't parse (which includes every construct holding a
+   TOKEN_INVALID) is marked invalid, without a root, and keeps its first error. The next edit touching it
+   parses it again.
+
+   The parser points at the document's tokens, so a Document must not be moved once it's initialized.
+**/
+
+struct Document_Construct {
+    s64 first_token;
+    s64 end_token;    // The ';' or TOKEN_EOF after it.
+    Ast_Index root;   // In parser.tree, AST_NULL if the construct is empty or invalid.
+    bool valid;       // False if it has a lexing or parsing error.
+
+    // The first error of an invalid construct: the token it's at, whose line and column are in
+    // tokens.locations, and the message, which the construct owns. -1 and NULL when valid.
+    s64 error_token;
+    char *error_message;
+};
+
+// What an edit did, for callers wanting to redo only their own work for the reparsed constructs.
+struct Document_Change {
+    s64 first_construct;       // Constructs [first_construct, first_construct + inserted_constructs) are new,
+    s64 removed_constructs;    // they replaced removed_constructs old ones.
+    s64 inserted_constructs;
+    s64 relexed_tokens;        // New tokens scanned, the resynchronizing one not counted.
+    bool compacted;            // Roots of the constructs that weren't reparsed changed too.
+};
+
+struct Document {
+    char *text;               // Nul terminated.
+    s64 text_count;
+    s64 text_capacity;
+
+    Lexer lexer;
+    Token_Buffer tokens;      // Always ends with TOKEN_EOF.
+    Token_Buffer relexed;     // Tokens scanned by the current edit.
+
+    // Builds the constructs, every construct's nodes are in parser.tree.
+    Parser parser;
+
+    Document_Construct *constructs;
+    s64 construct_count;
+    s64 construct_capacity;
+
+    s64 dead_nodes;           // Nodes in the tree which no construct uses anymore.
+};
+
+void document_init(Document *document, char *text);
+void document_deinit(Document *document);
+
+// Replaces removed_count bytes at offset with inserted_count bytes from inserted, then brings the tokens and
+// constructs up to date. Returns false and changes nothing if inserted holds a nul byte, which the text can't.
+bool document_edit(Document *document, s64 offset, s64 removed_count, char *inserted, s64 inserted_count, Document_Change *change=NULL);
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "Types.h"
+
+#include <string.h> // memcpy
+
 // Murmur32 hash implementation
 
 const u32 SEED = 0x58bc4716;
@@ -19,14 +23,14 @@ u32 murmur_32(void *data, s32 len) {
     u32 hash = SEED;
     u32 k = 0;
 
-    u32 *d = (u32 *)data;
+    u8 *d = (u8 *)data;
     s32 nblocks = len / 4;
     
-    u8 *tail = (u8 *)d+nblocks*4;
+    u8 *tail = d+nblocks*4;
     
-    // Groups of 4 bytes.
+    // Groups of 4 bytes. memcpy instead of a u32 * cast since the data doesn't have to be aligned.
     for (int i = 0; i < nblocks; ++i) {
-        k = d[i];
+        memcpy(&k, d + i*4, 4);
         k *= c1;
         k = (k << r1)  | (k >> (32 - r1));
         k *= c2;
@@ -61,4 +65,203 @@ u32 murmur_32(void *data, s32 len) {
     return hash;
 }
 
+/**
+
+   hash_64, a 64 bit hash in the style of wyhash (final version 4).
+
+   Everything is built on one operation, mum: multiply two 64 bit numbers into 128 bits and fold the two
+   halves together with xor. That mixes as well as several of murmur's shift/multiply rounds and eats 16
+   bytes per multiply instead of 4.
+
+     - Up to 16 bytes (most identifiers) is a handful of overlapping loads and two multiplies, no loops.
+     - Up to 48 bytes goes 16 bytes at a time.
+     - Longer input goes 48 bytes at a time over three independent lanes, so the multiplies of a stripe
+       can all be in flight at once. 64x64->128 multiplies don't exist in SSE2/AVX2, this is the wide path.
+
+   hash_64_init/update/final give the same result as hash_64 over the concatenated data, for hashing
+   things that don't sit in one buffer (like a whole file as a cache key). constexpr_hash_64 is the same
+   hash usable at compile time.
+
+**/
+
+constexpr u64 HASH_64_SECRET[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+
+// 64x64 -> 128 bit multiply, *a gets the low half and *b the high half.
+constexpr void hash_mum(u64 *a, u64 *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (u64)r;
+    *b = (u64)(r >> 64);
+#else
+    u64 ha = *a >> 32, hb = *b >> 32, la = (u32)*a, lb = (u32)*b;
+    u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    u64 t  = rl + (rm0 << 32);
+    u64 c  = t < rl;
+    u64 lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+constexpr u64 hash_mix(u64 a, u64 b) {
+    hash_mum(&a, &b);
+    return a ^ b;
+}
+
+// Little endian loads. The runtime hash uses memcpy, the constexpr one goes a byte at a time.
+struct Hash_Read_Memory {
+    static u64 read_64(const u8 *p) { u64 v; memcpy(&v, p, 8); return v; }
+    static u64 read_32(const u8 *p) { u32 v; memcpy(&v, p, 4); return v; }
+    static u64 read_8(const u8 *p)  { return *p; }
+};
+
+struct Hash_Read_Bytes {
+    static constexpr u64 read_8(const char *p)  { return (u8)*p; }
+    static constexpr u64 read_32(const char *p) { return read_8(p) | read_8(p + 1) << 8 | read_8(p + 2) << 16 | read_8(p + 3) << 24; }
+    static constexpr u64 read_64(const char *p) { return read_32(p) | read_32(p + 4) << 32; }
+};
+
+// The last step once everything but the final 16 bytes is folded into seed.
+constexpr u64 hash_64_finish(u64 a, u64 b, u64 seed, u64 len) {
+    a ^= HASH_64_SECRET[1];
+    b ^= seed;
+    hash_mum(&a, &b);
+    return hash_mix(a ^ HASH_64_SECRET[0] ^ len, b ^ HASH_64_SECRET[1]);
+}
+
+constexpr u64 hash_64_start(u64 seed) {
+    return seed ^ hash_mix(seed ^ HASH_64_SECRET[0], HASH_64_SECRET[1]);
+}
+
+// Up to 16 bytes, seed has already been through hash_64_start.
+template <typename Reader, typename Pointer>
+constexpr u64 hash_64_short(Pointer p, u64 len, u64 seed) {
+    u64 a = 0, b = 0;
+    if (len >= 4) {
+        // Two or four overlapping 4 byte loads cover every length from 4 to 16.
+        u64 skip = (len >> 3) << 2;
+        a = (Reader::read_32(p) << 32) | Reader::read_32(p + skip);
+        b = (Reader::read_32(p + len - 4) << 32) | Reader::read_32(p + len - 4 - skip);
+    } else if (len > 0) {
+        a = (Reader::read_8(p) << 16) | (Reader::read_8(p + (len >> 1)) << 8) | Reader::read_8(p + len - 1);
+    }
+    return hash_64_finish(a, b, seed, len);
+}
+
+// One 48 byte stripe over the three lanes.
+template <typename Reader, typename Pointer>
+constexpr void hash_64_stripe(Pointer p, u64 *seed, u64 *see1, u64 *see2) {
+    *seed = hash_mix(Reader::read_64(p)      ^ HASH_64_SECRET[1], Reader::read_64(p + 8)  ^ *seed);
+    *see1 = hash_mix(Reader::read_64(p + 16) ^ HASH_64_SECRET[2], Reader::read_64(p + 24) ^ *see1);
+    *see2 = hash_mix(Reader::read_64(p + 32) ^ HASH_64_SECRET[3], Reader::read_64(p + 40) ^ *see2);
+}
+
+// Hashes the last 1-48 bytes at p, p - 16 must still be readable when fewer than 16 are left.
+template <typename Reader, typename Pointer>
+constexpr u64 hash_64_tail(Pointer p, u64 left, u64 seed, u64 len) {
+    while (left > 16) {
+        seed = hash_mix(Reader::read_64(p) ^ HASH_64_SECRET[1], Reader::read_64(p + 8) ^ seed);
+        p    += 16;
+        left -= 16;
+    }
+    return hash_64_finish(Reader::read_64(p + left - 16), Reader::read_64(p + left - 8), seed, len);
+}
+
+template <typename Reader, typename Pointer>
+constexpr u64 hash_64_bytes(Pointer p, u64 len, u64 seed) {
+    seed = hash_64_start(seed);
+
+    if (len <= 16) { return hash_64_short<Reader>(p, len, seed); }
+
+    u64 left = len;
+    if (left > 48) {
+        u64 see1 = seed, see2 = seed;
+        do {
+            hash_64_stripe<Reader>(p, &seed, &see1, &see2);
+            p    += 48;
+            left -= 48;
+        } while (left > 48);
+        seed ^= see1 ^ see2;
+    }
+
+    return hash_64_tail<Reader>(p, left, seed, len);
+}
+
+inline u64 hash_64(void *data, s64 len, u64 seed = SEED) {
+    return hash_64_bytes<Hash_Read_Memory>((const u8 *)data, (u64)len, seed);
+}
+
+// Not an overload of hash_64: a const char * overload would also catch every runtime call with a char *
+// and send it down the byte at a time path.
+constexpr u64 constexpr_hash_64(const char *data, s64 len, u64 seed = SEED) {
+    return hash_64_bytes<Hash_Read_Bytes>(data, (u64)len, seed);
+}
+
+/**
+
+   Streaming hash_64. Input is held back until we know more follows it: a 48 byte stripe is only hashed
+   once there are more than 48 bytes, because the last 1-48 bytes go through hash_64_tail instead. We
+   also keep the 16 bytes before the held back ones since hash_64_tail may read up to 16 bytes back.
+
+**/
+
+struct Hash_64_State {
+    u64 seed;
+    u64 see1;
+    u64 see2;
+    u64 length;     // Total bytes seen so far.
+    s32 pending;    // Bytes held back in buffer after the first 16.
+    u8  buffer[16 + 48]; // The 16 bytes before the pending ones, then the pending ones.
+};
+
+inline void hash_64_init(Hash_64_State *state, u64 seed = SEED) {
+    state->seed    = hash_64_start(seed);
+    state->see1    = state->seed;
+    state->see2    = state->seed;
+    state->length  = 0;
+    state->pending = 0;
+}
+
+inline void hash_64_update(Hash_64_State *state, void *data, s64 len) {
+    const u8 *p = (const u8 *)data;
+    state->length += len;
 
+    while (len > 0) {
+        if (state->pending == 48) {
+            // There's more after these 48, so they are a full stripe.
+            hash_64_stripe<Hash_Read_Memory>(state->buffer + 16, &state->seed, &state->see1, &state->see2);
+            memcpy(state->buffer, state->buffer + 48, 16);
+            state->pending = 0;
+        }
+
+        if (state->pending == 0 && len > 48) {
+            // Go straight from the input while we know at least one more byte follows the stripe.
+            do {
+                hash_64_stripe<Hash_Read_Memory>(p, &state->seed, &state->see1, &state->see2);
+                p   += 48;
+                len -= 48;
+            } while (len > 48);
+            memcpy(state->buffer, p - 16, 16);
+        }
+
+        s64 take = 48 - state->pending;
+        if (take > len) { take = len; }
+        memcpy(state->buffer + 16 + state->pending, p, take);
+        state->pending += (s32)take;
+        p   += take;
+        len -= take;
+    }
+}
+
+inline u64 hash_64_final(Hash_64_State *state) {
+    u8 *p = state->buffer + 16;
+    u64 len = state->length;
+
+    if (len <= 16) { return hash_64_short<Hash_Read_Memory>((const u8 *)p, len, state->seed); }
+
+    u64 seed = state->seed;
+    if (len > 48) { seed ^= state->see1 ^ state->see2; }
+
+    return hash_64_tail<Hash_Read_Memory>((const u8 *)p, (u64)state->pending, seed, len);
+}
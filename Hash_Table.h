@@ -1,21 +1,37 @@
 #pragma once
 
 #include "Types.h"
+#include "Common.h"
 #include "Hash.h"
+#include "Arena.h"
 
 #include <assert.h>
+#include <stdio.h>  // table_dump_stats
 #include <string.h> // memset
-#include <stdlib.h> // calloc
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h> // _mm_prefetch
+#endif
 
 /**
 
    The structure of Hash_States was primarily inspired by nothings's std_ds.h hash table.
 
-   This is a Hash_Table implemention using Linear Probing. If you don't provide a hash function, the default
-   one used is murmur32 hash function and the default table size is 32 slots.
+   This is a Hash_Table implemention using Linear Probing. Keys are hashed and compared through Hash_Traits
+   which is picked at compile time from the key type (or passed as the third template argument), so the
+   hash and compare calls get inlined into the probe loops. The default table size is 32 slots.
+
+   Removing doesn't leave a tombstone behind. Instead the entries after the removed one in the same probe run
+   are shifted back into the hole (backward shift deletion), so the table looks exactly like the removed key was
+   never added. Probe lengths therefore only depend on what's in the table, not on how many inserts and removes
+   it has seen, and lookups for missing keys always end at a VACANT slot. The hash states are implemented
+   similar to how stb_ds hash hash uses them.
 
-   We use a canonical DELETED sentinel for removed hashes. The other hash states are implemented similar to how
-   stb_ds hash hash uses them.
+   The entries come from the Allocator given to table_init (the heap by default, pass arena_allocator to
+   keep a table in an arena). A zero initialized table works too, it allocates from the heap on its first
+   add or reserve. Growing doubles the table and moves the entries over using the hash cached in
+   each entry, keys are never hashed again. Use table_reserve when you know roughly how many items are coming
+   so the table is allocated once at the right size.
 
    We pack each entry into an 'Entry' struct for cache reasons so we will have at most 1 cache miss as there is
    a low probability that we will have a collision and therefore will not need to probe outside the cache line.
@@ -25,21 +41,97 @@
 
 **/
 
+/**
+
+   Define HASH_TABLE_STATS to have every table count how its lookups go: a probe length histogram for hits
+   and for misses, and how often it was resized. Without it the counters and the code updating them don't
+   exist at all. table_dump_stats works either way, it also prints what it can work out from the entries
+   themselves (load, bytes, how far entries sit from their home slot).
+
+**/
+
+const s32 HASH_TABLE_PROBE_BUCKETS = 16; // Probe lengths 1 to 15, the last bucket is everything longer.
+
+struct Hash_Table_Stats {
+    s64 hits;
+    s64 misses;
+    s64 hit_probes[HASH_TABLE_PROBE_BUCKETS];
+    s64 miss_probes[HASH_TABLE_PROBE_BUCKETS];
+    s64 resizes;
+};
+
+#ifdef HASH_TABLE_STATS
+#define HASH_TABLE_STAT(statement) statement
+#else
+#define HASH_TABLE_STAT(statement)
+#endif
+
+inline s32 table_probe_bucket(s64 probes) {
+    if (probes > HASH_TABLE_PROBE_BUCKETS) { return HASH_TABLE_PROBE_BUCKETS - 1; }
+    return (s32)probes - 1;
+}
+
 enum HASH_STATE : u8 {
     VACANT  = 0,
-    DELETED = 1,
-    VALID   = 2,
+    VALID   = 1,
 };
 
 inline u32 next_power_of_two(u32 x) {
     assert(x != 0);
-    int p = 1;
+    u32 p = 1;
     while (x > p) { p += p; }
 
     return p;
 }
 
-template <typename Key_Type, typename Value_Type>
+/**
+
+   Hash_Traits tells the table how to hash and compare a key type.
+
+   The default hashes the bytes of the key itself with hash_64 and compares with ==, which is what you
+   want for integers, enums and pointers you really mean to compare by address.
+
+   C strings and String are hashed and compared by their contents instead. They also support looking up
+   by a (pointer, length) pair directly, see the table_find_pointer overload taking data and count, so
+   you can look up a slice of the source without building a key first.
+
+   To use something else write a struct with static hash and equal functions and pass it as the
+   third template argument to Hash_Table.
+
+**/
+
+template <typename Key_Type>
+struct Hash_Traits {
+    static u32  hash(const Key_Type &key)                    { return (u32)hash_64((void *)&key, sizeof(key)); }
+    static bool equal(const Key_Type &a, const Key_Type &b)  { return a == b; }
+};
+
+template <>
+struct Hash_Traits<String> {
+    static u32  hash(const String &key)                      { return (u32)hash_64((void *)key.data, key.count); }
+    static bool equal(const String &a, const String &b)      { return a == b; }
+
+    static u32  hash(char *data, s64 count)                  { return (u32)hash_64((void *)data, count); }
+    static bool equal(const String &key, char *data, s64 count) {
+        return key.count == count && memcmp(key.data, data, count) == 0;
+    }
+};
+
+template <>
+struct Hash_Traits<const char *> {
+    static u32  hash(const char *key)                        { return (u32)hash_64((void *)key, strlen(key)); }
+    static bool equal(const char *a, const char *b)          { return strcmp(a, b) == 0; }
+
+    static u32  hash(char *data, s64 count)                  { return (u32)hash_64((void *)data, count); }
+    static bool equal(const char *key, char *data, s64 count) {
+        return strncmp(key, data, count) == 0 && key[count] == '\0';
+    }
+};
+
+template <>
+struct Hash_Traits<char *> : Hash_Traits<const char *> {};
+
+template <typename Key_Type, typename Value_Type, typename Traits = Hash_Traits<Key_Type>>
 struct Hash_Table {
     s32 table_size; // The total size of the table. This should be a power of 2 for quick cache accesses.
     s32 items;      // The number of VALID items in the table.
@@ -56,104 +148,135 @@ struct Hash_Table {
 
     Entry *entries;
 
-    u32  (*hash_function)(void *, s32);               // void pointer to data and length.
-    bool (*comparator_function)(Key_Type, Key_Type);  // comparator function for comparing keys.
-};
+    Allocator allocator;
 
+#ifdef HASH_TABLE_STATS
+    Hash_Table_Stats stats;
+#endif
+};
 
-template <typename Key_Type>
-bool default_comparator_function(Key_Type a, Key_Type b) { 
-    return a == b;
+// Hashes below VALID are reserved for the hash states so bump them out of the way.
+inline u32 table_valid_hash(u32 hash) {
+    if (hash < HASH_STATE::VALID) { hash += HASH_STATE::VALID; }
+    return hash;
 }
 
+// Points the table at a fresh, empty array of table_size slots. Doesn't free the old one.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_allocate_entries(Hash_Table <Key_Type, Value_Type, Traits> *table, s32 table_size) {
+    typedef typename Hash_Table <Key_Type, Value_Type, Traits>::Entry Entry;
 
-template <typename Key_Type, typename Value_Type>
-inline void table_init(Hash_Table <Key_Type, Value_Type> *table, s64 _table_size=0, bool (*given_comparator)(Key_Type, Key_Type )=NULL, u32 (*given_hash_function)(void *, s32)=NULL) {
-    if (!given_hash_function) {
-        table->hash_function = murmur_32;
-    } else {
-        table->hash_function = given_hash_function;
-    }
-
-    if (!given_comparator) {
-        table->comparator_function = default_comparator_function;
-    } else {
-        table->comparator_function = given_comparator;
-    }
-
-    if (_table_size == 0) { _table_size = table->MIN_SIZE; }
-
-    u32 aligned_table_size = next_power_of_two(_table_size);
+    // A zero initialized table was never given an allocator.
+    if (!table->allocator.allocate) { table->allocator = heap_allocator(); }
 
-    table->table_size = aligned_table_size;
-    table->items      = 0;
+    table->table_size = table_size;
+    table->entries    = (Entry *)allocator_alloc(table->allocator, table_size * sizeof(Entry), alignof(Entry));
+    memset(table->entries, 0, table_size * sizeof(Entry));
 
-    table->entries = (typename Hash_Table <Key_Type, Value_Type>::Entry *) calloc(table->table_size, sizeof(typename Hash_Table <Key_Type, Value_Type>::Entry));
+    table->resize_threshold = (table->table_size * table->LOAD_FACTOR_PERCENT) / 100;
+}
 
-    memset(table->entries, 0, table->table_size*sizeof(typename Hash_Table <Key_Type, Value_Type>::Entry));
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_init(Hash_Table <Key_Type, Value_Type, Traits> *table, s64 _table_size=0, Allocator allocator=heap_allocator()) {
+    if (_table_size == 0) { _table_size = table->MIN_SIZE; }
 
-    table->resize_threshold = (table->table_size * table->LOAD_FACTOR_PERCENT) / 100;
+    table->items     = 0;
+    table->allocator = allocator;
+    HASH_TABLE_STAT(memset(&table->stats, 0, sizeof(table->stats)));
+    table_allocate_entries(table, (s32)next_power_of_two(_table_size));
 }
 
-template <typename Key_Type, typename Value_Type>
-inline void table_deinit(Hash_Table <Key_Type, Value_Type> *table) {
-    free(table->entries);
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_deinit(Hash_Table <Key_Type, Value_Type, Traits> *table) {
+    if (!table->entries) { return; }
+    allocator_free(table->allocator, table->entries, table->table_size * sizeof(*table->entries));
 }
 
-template <typename Key_Type, typename Value_Type>
-inline void table_expand(Hash_Table <Key_Type, Value_Type> *table) {
+// Moves every entry into a new array of new_table_size slots. The entries keep their cached hash.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_resize(Hash_Table <Key_Type, Value_Type, Traits> *table, s32 new_table_size) {
     auto *old_entries = table->entries;
     s32   old_size    = table->table_size;
 
+    assert(new_table_size >= table->items);
+    table_allocate_entries(table, new_table_size);
+    HASH_TABLE_STAT(table->stats.resizes++);
+
+    u32 mask = table->table_size - 1;
+    for (s32 i = 0; i < old_size; ++i) {
+        auto *entry = &old_entries[i];
+        if (entry->hash < HASH_STATE::VALID) { continue; }
+
+        u32 index = entry->hash & mask;
+        while (table->entries[index].hash) { index = (index + 1) & mask; }
+        table->entries[index] = *entry;
+    }
+
+    allocator_free(table->allocator, old_entries, old_size * sizeof(*old_entries));
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_expand(Hash_Table <Key_Type, Value_Type, Traits> *table) {
     s32 new_table_size = table->table_size * 2;
     if (new_table_size < table->MIN_SIZE) {
         new_table_size = table->MIN_SIZE;
     }
 
-    table_init(table, new_table_size);
+    table_resize(table, new_table_size);
+}
 
-    for (s32 i = 0; i < old_size; ++i) {
-        auto *entry = &old_entries[i];
-        if (entry->hash >= HASH_STATE::VALID) {
-            table_add(table, entry->key, entry->value);
-        }
-    }
+// Makes sure count items fit without the table growing.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_reserve(Hash_Table <Key_Type, Value_Type, Traits> *table, s64 count) {
+    s64 needed = table->table_size;
+    if (needed < table->MIN_SIZE) { needed = table->MIN_SIZE; }
+    while ((needed * table->LOAD_FACTOR_PERCENT) / 100 < count) { needed *= 2; }
 
-    free(old_entries);
+    if (needed > table->table_size) { table_resize(table, (s32)needed); }
 }
 
-template <typename Key_Type, typename Value_Type>
-inline bool table_remove(Hash_Table <Key_Type, Value_Type> *table, Key_Type key) {
-    u32 hash = table->hash_function((void *)&key, sizeof(key));
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline bool table_remove(Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type key) {
+    if (!table->table_size) { return false; }
 
-    if (hash < HASH_STATE::VALID) { hash += HASH_STATE::VALID; }
+    u32 hash = table_valid_hash(Traits::hash(key));
+    u32 mask = table->table_size - 1;
 
-    u32 index = hash & (table->table_size - 1);
+    u32 index = hash & mask;
 
     while (table->entries[index].hash) {
         auto *entry = &table->entries[index];
-        if (entry->hash == hash && table->comparator_function(entry->key, key)) {
-            entry->hash = HASH_STATE::DELETED;
-            --table->items;
-            return true;
+        if (entry->hash == hash && Traits::equal(entry->key, key)) {
+            break;
         }
 
-        index += 1;
-        if (index >= table->table_size) { index = 0; }
+        index = (index + 1) & mask;
     }
 
-    return false;
-}
-
-template <typename Key_Type, typename Value_Type>
-inline void table_add(Hash_Table <Key_Type, Value_Type> *table, Key_Type key, Value_Type value) {
-    if (table->items >= table->resize_threshold) { table_expand(table); }
-
-    assert(table->items <= table->table_size);
+    if (!table->entries[index].hash) { return false; }
+
+    // Walk the rest of the run and pull back every entry which is allowed to live in the hole, that is every
+    // entry whose home slot isn't between the hole and where it is now.
+    u32 hole = index;
+    u32 next = (index + 1) & mask;
+    while (table->entries[next].hash) {
+        u32 home = table->entries[next].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            table->entries[hole] = table->entries[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
 
-    u32 hash = table->hash_function((void *)&key, sizeof(key));
+    table->entries[hole].hash = HASH_STATE::VACANT;
+    --table->items;
+    return true;
+}
 
-    if (hash < HASH_STATE::VALID) { hash += HASH_STATE::VALID; }
+// Adds with a hash that has already been computed (and made valid). There must be room for one more item.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_add_hashed(Hash_Table <Key_Type, Value_Type, Traits> *table, u32 hash, Key_Type key, Value_Type value) {
+    assert(table->items < table->table_size);
 
     u32 index = hash & (table->table_size - 1);
 
@@ -167,43 +290,65 @@ inline void table_add(Hash_Table <Key_Type, Value_Type> *table, Key_Type key, Va
             return;
         }
 
-        index += 1;
-        if (index >= table->table_size) { index = 0; }
+        index = (index + 1) & (table->table_size - 1);
     }
 }
 
-template <typename Key_Type, typename Value_Type>
-inline Value_Type *table_find_pointer(Hash_Table <Key_Type, Value_Type> *table, Key_Type key) {
-    if (!table->table_size) { return NULL; }
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_add(Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type key, Value_Type value) {
+    if (table->items >= table->resize_threshold) { table_expand(table); }
 
-    u32 hash = table->hash_function((void *)&key, sizeof(key));
+    u32 hash = table_valid_hash(Traits::hash(key));
+    table_add_hashed(table, hash, key, value);
+}
 
-    if (hash <= HASH_STATE::VALID) { hash += HASH_STATE::VALID; }
+// Probes for an entry with the given (already valid) hash for which matches(key) is true.
+template <typename Key_Type, typename Value_Type, typename Traits, typename Matcher>
+inline Value_Type *table_find_pointer_hashed(Hash_Table <Key_Type, Value_Type, Traits> *table, u32 hash, Matcher matches) {
+    if (!table->table_size) { return NULL; }
 
     u32 index = hash & (table->table_size - 1);
+    HASH_TABLE_STAT(s64 probes = 1);
 
     while (table->entries[index].hash) {
         auto *entry = &table->entries[index];
-        if (entry->hash == hash && table->comparator_function(entry->key, key)) {
+        if (entry->hash == hash && matches(entry->key)) {
+            HASH_TABLE_STAT(table->stats.hits++);
+            HASH_TABLE_STAT(table->stats.hit_probes[table_probe_bucket(probes)]++);
             return &entry->value;
         }
 
-        index += 1;
-        if (index >= table->table_size) { index = 0; }
+        index = (index + 1) & (table->table_size - 1);
+        HASH_TABLE_STAT(probes++);
     }
 
+    HASH_TABLE_STAT(table->stats.misses++);
+    HASH_TABLE_STAT(table->stats.miss_probes[table_probe_bucket(probes)]++);
     return NULL;
 }
 
-template <typename Key_Type, typename Value_Type>
-inline bool table_find(Hash_Table <Key_Type, Value_Type> *table, Key_Type key) {
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline Value_Type *table_find_pointer(Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type key) {
+    u32 hash = table_valid_hash(Traits::hash(key));
+    return table_find_pointer_hashed(table, hash, [&](const Key_Type &other) { return Traits::equal(other, key); });
+}
+
+// Looks up a string keyed table by a slice without building a key. Only for traits which support it.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline Value_Type *table_find_pointer(Hash_Table <Key_Type, Value_Type, Traits> *table, char *data, s64 count) {
+    u32 hash = table_valid_hash(Traits::hash(data, count));
+    return table_find_pointer_hashed(table, hash, [&](const Key_Type &other) { return Traits::equal(other, data, count); });
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline bool table_find(Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type key) {
     Value_Type *value = table_find_pointer(table, key);
     if (!value) { return false; }
     return true;
 }
 
-template <typename Key_Type, typename Value_Type>
-inline void table_set(Hash_Table <Key_Type, Value_Type> *table, Key_Type key, Value_Type new_value) {
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_set(Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type key, Value_Type new_value) {
     Value_Type *old_value = table_find_pointer(table, key);
     if (old_value) {  // If there exists an old value just point the old value to the new value.
         *old_value = new_value;
@@ -211,3 +356,112 @@ inline void table_set(Hash_Table <Key_Type, Value_Type> *table, Key_Type key, Va
         table_add(table, key, new_value);
     }
 }
+
+inline void table_print_histogram(FILE *out, const char *label, s64 *buckets, s64 total) {
+    if (!total) { return; }
+
+    fprintf(out, "  %s:\n", label);
+    for (s32 i = 0; i < HASH_TABLE_PROBE_BUCKETS; ++i) {
+        if (!buckets[i]) { continue; }
+        const char *more = (i == HASH_TABLE_PROBE_BUCKETS - 1) ? "+" : " ";
+        fprintf(out, "    %3d%s %10lld  %5.1f%%\n", i + 1, more, (long long)buckets[i], 100.0 * buckets[i] / total);
+    }
+}
+
+// Prints the state of the table and, with HASH_TABLE_STATS, the lookup counters. name is only used as a heading.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_dump_stats(Hash_Table <Key_Type, Value_Type, Traits> *table, const char *name, FILE *out=stdout) {
+    // How far each entry sits from its home slot, that's the probe length a hit on it costs.
+    s64 displacement[HASH_TABLE_PROBE_BUCKETS] = {};
+    s64 longest_run = 0;
+    s64 run         = 0;
+
+    u32 mask = table->table_size - 1;
+    for (s32 i = 0; i < table->table_size; ++i) {
+        auto *entry = &table->entries[i];
+        if (!entry->hash) { run = 0; continue; }
+
+        if (++run > longest_run) { longest_run = run; }
+        displacement[table_probe_bucket(((i - (entry->hash & mask)) & mask) + 1)]++;
+    }
+
+    s64 bytes = table->table_size * sizeof(*table->entries);
+
+    fprintf(out, "%s:\n", name);
+    fprintf(out, "  items %d, slots %d, load %.1f%%, %lld bytes\n", table->items, table->table_size,
+            100.0 * table->items / table->table_size, (long long)bytes);
+    fprintf(out, "  tombstones 0 (removal shifts entries back), longest run %lld\n", (long long)longest_run);
+    table_print_histogram(out, "probes to reach each entry", displacement, table->items);
+
+#ifdef HASH_TABLE_STATS
+    Hash_Table_Stats *stats = &table->stats;
+    fprintf(out, "  resizes %lld, hits %lld, misses %lld\n", (long long)stats->resizes, (long long)stats->hits, (long long)stats->misses);
+    table_print_histogram(out, "hit probe lengths",  stats->hit_probes,  stats->hits);
+    table_print_histogram(out, "miss probe lengths", stats->miss_probes, stats->misses);
+#endif
+}
+
+/**
+
+   Batched operations.
+
+   A lookup in a big table is mostly waiting on the cache miss for the home slot. When we have a bunch of
+   independent keys we hash a group of them first, prefetch all of their home slots, and only then walk the
+   probes, so the misses for the whole group are in flight at the same time instead of one after the other.
+
+**/
+
+const s32 TABLE_BATCH_SIZE = 16;
+
+inline void table_prefetch(void *address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#elif defined(_MSC_VER)
+    _mm_prefetch((char *)address, _MM_HINT_T0);
+#endif
+}
+
+// results[i] is set to the value pointer for keys[i], or NULL if it isn't in the table.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_find_batch(Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type *keys, s64 count, Value_Type **results) {
+    u32 hashes[TABLE_BATCH_SIZE];
+    u32 mask = table->table_size - 1;
+
+    for (s64 start = 0; start < count; start += TABLE_BATCH_SIZE) {
+        s64 batch = count - start;
+        if (batch > TABLE_BATCH_SIZE) { batch = TABLE_BATCH_SIZE; }
+
+        for (s64 i = 0; i < batch; ++i) {
+            hashes[i] = table_valid_hash(Traits::hash(keys[start + i]));
+            if (table->table_size) { table_prefetch(&table->entries[hashes[i] & mask]); }
+        }
+
+        for (s64 i = 0; i < batch; ++i) {
+            Key_Type &key = keys[start + i];
+            results[start + i] = table_find_pointer_hashed(table, hashes[i], [&](const Key_Type &other) { return Traits::equal(other, key); });
+        }
+    }
+}
+
+// Same as calling table_add for every pair, but the table is reserved up front so no slot we prefetched moves.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_add_batch(Hash_Table <Key_Type, Value_Type, Traits> *table, Key_Type *keys, Value_Type *values, s64 count) {
+    table_reserve(table, table->items + count);
+
+    u32 hashes[TABLE_BATCH_SIZE];
+    u32 mask = table->table_size - 1;
+
+    for (s64 start = 0; start < count; start += TABLE_BATCH_SIZE) {
+        s64 batch = count - start;
+        if (batch > TABLE_BATCH_SIZE) { batch = TABLE_BATCH_SIZE; }
+
+        for (s64 i = 0; i < batch; ++i) {
+            hashes[i] = table_valid_hash(Traits::hash(keys[start + i]));
+            table_prefetch(&table->entries[hashes[i] & mask]);
+        }
+
+        for (s64 i = 0; i < batch; ++i) {
+            table_add_hashed(table, hashes[i], keys[start + i], values[start + i]);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#include "Interner.h"
+
+#include <stdlib.h> // realloc, free
+
+void interner_init(Interner *interner) { 
+    assert(interner);
+    table_init(&interner->table, 0);
+    arena_init(&interner->arena);
+
+    interner->names_capacity = 256;
+    interner->names = (String *)malloc(interner->names_capacity * sizeof(String));
+    assert(interner->names);
+
+    // Atom 0 is ATOM_NONE.
+    interner->names[ATOM_NONE] = {};
+    interner->unique_count = 0;
+    interner->total_count  = 0;
+    interner->bytes_used   = 0;
+}
+
+void interner_deinit(Interner *interner) { 
+    assert(interner);
+    table_deinit(&interner->table);
+    arena_deinit(&interner->arena);
+    free(interner->names);
+
+    interner->names          = NULL;
+    interner->names_capacity = 0;
+    interner->unique_count   = 0;
+    interner->total_count    = 0;
+    interner->bytes_used     = 0;
+}
+
+bool interner_is_initialized(Interner *interner) { 
+    return interner->names != NULL;
+}
+
+Atom intern(Interner *interner, char *data, s64 count) { 
+    assert(interner && interner->names && data && count >= 0);
+    ++interner->total_count;
+
+    Atom *found = table_find_pointer(&interner->table, data, count);
+    if (found) { return *found; }
+
+    // First time we see this one, copy it somewhere that will outlive the source.
+    char *name = (char *)arena_alloc(&interner->arena, count + 1, 1);
+    memcpy(name, data, count);
+    name[count] = '\0';
+    interner->bytes_used += count + 1;
+
+    Atom atom = (Atom)(++interner->unique_count);
+    if (atom >= interner->names_capacity) { 
+        interner->names_capacity *= 2;
+        interner->names = (String *)realloc(interner->names, interner->names_capacity * sizeof(String));
+        assert(interner->names);
+    }
+
+    String interned = { name, count };
+    interner->names[atom] = interned;
+    table_add(&interner->table, interned, atom);
+
+    return atom;
+}
+
+String interner_get(Interner *interner, Atom atom) { 
+    assert(interner && atom != ATOM_NONE && atom <= interner->unique_count);
+    return interner->names[atom];
+}
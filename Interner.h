@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Types.h"
+#include "Common.h"
+#include "Arena.h"
+#include "Hash_Table.h"
+
+/**
+   Stores every distinct name once and hands out a small integer (an Atom) for it.
+
+   The same identifiers show up over and over again in source code, so instead of copying the name for
+   every occurrence we look it up here and only copy it the first time we see it. Later phases can then
+   compare names by comparing atoms.
+
+   The names are kept nul terminated in the interner's arena and never move, so the pointer returned by
+   interner_get stays valid until interner_deinit.
+
+   Atom 0 (ATOM_NONE) is never handed out.
+**/
+
+typedef u32 Atom;
+
+const Atom ATOM_NONE = 0;
+
+struct Interner { 
+    Hash_Table<String, Atom> table;  // Name to atom, the key points into arena.
+    Arena arena;                     // Characters of every interned name.
+
+    String *names;         // Atom to name, indexed by the atom.
+    s64 names_capacity;
+    s64 unique_count;      // Number of distinct names.
+    s64 total_count;       // Number of calls to intern, repeats included.
+    s64 bytes_used;        // Bytes of name characters (with nul terminators) we are holding on to.
+};
+
+void interner_init(Interner *interner);
+void interner_deinit(Interner *interner);
+bool interner_is_initialized(Interner *interner);
+Atom intern(Interner *interner, char *data, s64 count);
+String interner_get(Interner *interner, Atom atom);
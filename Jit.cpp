@@ -0,0 +1,328 @@
+#include "Jit.h"
+
+#include <assert.h>
+#include <stdlib.h> // malloc
+#include <string.h> // memcpy
+
+#if defined(__linux__) && defined(__x86_64__)
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#endif
+
+#if JIT_SUPPORTED
+
+const s32 JIT_REGISTER_COUNT = 16; // xmm0 - xmm15
+
+// SSE2 scalar double instructions, all F2 0F xx /r.
+const u8 SSE_MOVSD = 0x10;
+const u8 SSE_ADDSD = 0x58;
+const u8 SSE_MULSD = 0x59;
+const u8 SSE_SUBSD = 0x5c;
+const u8 SSE_DIVSD = 0x5e;
+
+// 66 0F 57 /r
+const u8 SSE_XORPD = 0x57;
+
+enum Operand_Kind : u8 {
+    OPERAND_REGISTER,
+    OPERAND_VARIABLE,  // [rdi + 8 * index]
+    OPERAND_CONSTANT,  // [rip + offset of constant index in the pool]
+    OPERAND_SIGN_MASK, // [rip + offset of the 16 byte sign mask]
+};
+
+struct Operand {
+    Operand_Kind kind;
+    s64 index;
+};
+
+// A rip relative displacement we can only fill in once we know where the constant pool starts.
+struct Jit_Fixup {
+    s64 position;      // Of the disp32 in the code.
+    s64 pool_offset;   // Of what it refers to, from the start of the pool.
+};
+
+struct Jit_Compiler {
+    Ast_Tree *tree;
+
+    u8 *code;
+    s64 code_count;
+    s64 code_capacity;
+
+    f64 *constants;
+    s64 constant_count;
+    s64 constant_capacity;
+
+    Jit_Fixup *fixups;
+    s64 fixup_count;
+    s64 fixup_capacity;
+
+    s64 variable_count;
+    bool failed;
+};
+
+// The pool starts with the sign mask (16 bytes, xorpd wants them aligned), then one f64 per constant.
+const s64 POOL_SIGN_MASK = 0;
+const s64 POOL_CONSTANTS = 16;
+
+static void emit_byte(Jit_Compiler *compiler, u8 byte) {
+    if (compiler->code_count >= compiler->code_capacity) {
+        s64 capacity = compiler->code_capacity * 2;
+        if (capacity < 256) { capacity = 256; }
+        compiler->code = (u8 *)realloc(compiler->code, capacity);
+        assert(compiler->code);
+        compiler->code_capacity = capacity;
+    }
+    compiler->code[compiler->code_count++] = byte;
+}
+
+static void emit_u32(Jit_Compiler *compiler, u32 value) {
+    for (s32 i = 0; i < 4; ++i) { emit_byte(compiler, (u8)(value >> (i * 8))); }
+}
+
+static void add_fixup(Jit_Compiler *compiler, s64 pool_offset) {
+    if (compiler->fixup_count >= compiler->fixup_capacity) {
+        s64 capacity = compiler->fixup_capacity * 2;
+        if (capacity < 32) { capacity = 32; }
+        compiler->fixups = (Jit_Fixup *)realloc(compiler->fixups, capacity * sizeof(Jit_Fixup));
+        assert(compiler->fixups);
+        compiler->fixup_capacity = capacity;
+    }
+
+    Jit_Fixup *fixup = &compiler->fixups[compiler->fixup_count++];
+    fixup->position    = compiler->code_count;
+    fixup->pool_offset = pool_offset;
+}
+
+static s64 add_constant(Jit_Compiler *compiler, f64 value) {
+    for (s64 i = 0; i < compiler->constant_count; ++i) {
+        if (memcmp(&compiler->constants[i], &value, sizeof(f64)) == 0) { return i; }
+    }
+
+    if (compiler->constant_count >= compiler->constant_capacity) {
+        s64 capacity = compiler->constant_capacity * 2;
+        if (capacity < 16) { capacity = 16; }
+        compiler->constants = (f64 *)realloc(compiler->constants, capacity * sizeof(f64));
+        assert(compiler->constants);
+        compiler->constant_capacity = capacity;
+    }
+
+    compiler->constants[compiler->constant_count] = value;
+    return compiler->constant_count++;
+}
+
+// prefix [REX] 0F opcode ModRM [disp32], destination is always an xmm register.
+static void emit_sse(Jit_Compiler *compiler, u8 prefix, u8 opcode, s32 destination, Operand source) {
+    u8 rex = 0x40;
+    if (destination >= 8) { rex |= 0x04; } // REX.R
+    if (source.kind == OPERAND_REGISTER && source.index >= 8) { rex |= 0x01; } // REX.B
+
+    emit_byte(compiler, prefix);
+    if (rex != 0x40) { emit_byte(compiler, rex); }
+    emit_byte(compiler, 0x0f);
+    emit_byte(compiler, opcode);
+
+    u8 reg = (u8)((destination & 7) << 3);
+    switch (source.kind) {
+        case OPERAND_REGISTER: {
+            emit_byte(compiler, 0xc0 | reg | (u8)(source.index & 7));
+        } break;
+        case OPERAND_VARIABLE: {
+            emit_byte(compiler, 0x80 | reg | 7); // mod 10, rm rdi, disp32
+            emit_u32(compiler, (u32)(source.index * 8));
+        } break;
+        case OPERAND_CONSTANT: {
+            emit_byte(compiler, reg | 5); // mod 00, rm 101 is rip + disp32
+            add_fixup(compiler, POOL_CONSTANTS + source.index * 8);
+            emit_u32(compiler, 0);
+        } break;
+        case OPERAND_SIGN_MASK: {
+            emit_byte(compiler, reg | 5);
+            add_fixup(compiler, POOL_SIGN_MASK);
+            emit_u32(compiler, 0);
+        } break;
+    }
+}
+
+// Literals and variables can be used as an operand without loading them first. Returns false for anything else.
+static bool leaf_operand(Jit_Compiler *compiler, Ast_Index index, Operand *operand) {
+    Ast_Kind kind = compiler->tree->kinds[index];
+    Ast_Payload *payload = &compiler->tree->payloads[index];
+
+    switch (kind) {
+        case AST_INT:
+        case AST_BOOL: {
+            *operand = {OPERAND_CONSTANT, add_constant(compiler, (f64)payload->integer_value)};
+            return true;
+        }
+        case AST_FLOAT: {
+            *operand = {OPERAND_CONSTANT, add_constant(compiler, payload->float_value)};
+            return true;
+        }
+        case AST_IDENTIFIER: {
+            Atom atom = payload->identifier.atom;
+            // The displacement is a signed 32 bit number of bytes.
+            if (atom >= 0x10000000) { compiler->failed = true; }
+            if (atom + 1 > compiler->variable_count) { compiler->variable_count = atom + 1; }
+            *operand = {OPERAND_VARIABLE, (s64)atom};
+            return true;
+        }
+        default: break;
+    }
+    return false;
+}
+
+// Leaves the value of the node in xmm<target>.
+static void compile_node(Jit_Compiler *compiler, Ast_Index index, s32 target) {
+    if (compiler->failed) { return; }
+    if (target >= JIT_REGISTER_COUNT) { compiler->failed = true; return; }
+
+    Ast_Kind kind = compiler->tree->kinds[index];
+    Ast_Payload *payload = &compiler->tree->payloads[index];
+
+    Operand leaf;
+    if (leaf_operand(compiler, index, &leaf)) {
+        emit_sse(compiler, 0xf2, SSE_MOVSD, target, leaf);
+        return;
+    }
+
+    switch (kind) {
+        case AST_PLUS: {
+            compile_node(compiler, payload->unary.operand, target);
+        } break;
+        case AST_NEGATE: {
+            compile_node(compiler, payload->unary.operand, target);
+            emit_sse(compiler, 0x66, SSE_XORPD, target, {OPERAND_SIGN_MASK, 0});
+        } break;
+
+        case AST_ADD:
+        case AST_SUBTRACT:
+        case AST_MULTIPLY:
+        case AST_DIVIDE: {
+            u8 opcode = SSE_ADDSD;
+            if (kind == AST_SUBTRACT) { opcode = SSE_SUBSD; }
+            if (kind == AST_MULTIPLY) { opcode = SSE_MULSD; }
+            if (kind == AST_DIVIDE)   { opcode = SSE_DIVSD; }
+
+            compile_node(compiler, payload->binary.left, target);
+
+            Operand right;
+            if (!leaf_operand(compiler, payload->binary.right, &right)) {
+                compile_node(compiler, payload->binary.right, target + 1);
+                right = {OPERAND_REGISTER, target + 1};
+            }
+            emit_sse(compiler, 0xf2, opcode, target, right);
+        } break;
+
+        default: {
+            compiler->failed = true;
+        } break;
+    }
+}
+
+bool jit_compile(Jit_Function *function, Ast_Tree *tree, Ast_Index root) {
+    assert(function && tree && root != AST_NULL && root < tree->count);
+    *function = {};
+
+    Jit_Compiler compiler = {};
+    compiler.tree = tree;
+
+    compile_node(&compiler, root, 0);
+    emit_byte(&compiler, 0xc3); // ret
+
+    bool ok = !compiler.failed;
+    if (ok) {
+        s64 pool_start = (compiler.code_count + 15) & ~(s64)15;
+        s64 size       = pool_start + POOL_CONSTANTS + compiler.constant_count * sizeof(f64);
+
+        void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        ok = memory != MAP_FAILED;
+
+        if (ok) {
+            u8 *bytes = (u8 *)memory;
+            memcpy(bytes, compiler.code, compiler.code_count);
+            memset(bytes + compiler.code_count, 0xcc, pool_start - compiler.code_count); // int3 padding
+
+            u64 sign_mask[2] = {0x8000000000000000ull, 0x8000000000000000ull};
+            memcpy(bytes + pool_start + POOL_SIGN_MASK, sign_mask, sizeof(sign_mask));
+            if (compiler.constant_count) {
+                memcpy(bytes + pool_start + POOL_CONSTANTS, compiler.constants, compiler.constant_count * sizeof(f64));
+            }
+
+            // rip relative displacements count from the end of the instruction, which is right after the disp32.
+            for (s64 i = 0; i < compiler.fixup_count; ++i) {
+                Jit_Fixup *fixup = &compiler.fixups[i];
+                s32 displacement = (s32)(pool_start + fixup->pool_offset - (fixup->position + 4));
+                memcpy(bytes + fixup->position, &displacement, 4);
+            }
+
+            ok = mprotect(memory, size, PROT_READ | PROT_EXEC) == 0;
+            if (ok) {
+                function->entry          = (Jit_Entry)memory;
+                function->memory         = memory;
+                function->memory_size    = size;
+                function->variable_count = compiler.variable_count;
+            } else {
+                munmap(memory, size);
+            }
+        }
+    }
+
+    free(compiler.code);
+    free(compiler.constants);
+    free(compiler.fixups);
+    return ok;
+}
+
+void jit_free(Jit_Function *function) {
+    assert(function);
+    if (function->memory) { munmap(function->memory, function->memory_size); }
+    *function = {};
+}
+
+#else
+
+bool jit_compile(Jit_Function *function, Ast_Tree *tree, Ast_Index root) {
+    (void)tree; (void)root;
+    *function = {};
+    return false;
+}
+
+void jit_free(Jit_Function *function) {
+    *function = {};
+}
+
+#endif // JIT_SUPPORTED
+
+void compiled_expression_init(Compiled_Expression *expression, Ast_Tree *tree, Ast_Index root) {
+    assert(expression && tree);
+    *expression = {};
+    expression->tree = tree;
+    expression->root = root;
+
+    if (jit_compile(&expression->jit, tree, root)) {
+        expression->method = EVALUATE_JIT;
+    } else if (bytecode_compile(&expression->bytecode, tree, root)) {
+        expression->method = EVALUATE_BYTECODE;
+    } else {
+        expression->method = EVALUATE_TREE;
+    }
+}
+
+void compiled_expression_deinit(Compiled_Expression *expression) {
+    assert(expression);
+    if (expression->method == EVALUATE_JIT)      { jit_free(&expression->jit); }
+    if (expression->method == EVALUATE_BYTECODE) { bytecode_deinit(&expression->bytecode); }
+    *expression = {};
+}
+
+f64 compiled_expression_run(Compiled_Expression *expression, f64 *variables, s64 variable_count) {
+    switch (expression->method) {
+        case EVALUATE_JIT: {
+            assert(variable_count >= expression->jit.variable_count);
+            return expression->jit.entry(variables);
+        }
+        case EVALUATE_BYTECODE: return bytecode_run(&expression->bytecode, variables, variable_count);
+        case EVALUATE_TREE:     return ast_evaluate(expression->tree, expression->root, variables, variable_count);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Types.h"
+#include "Ast.h"
+#include "Bytecode.h"
+
+/**
+   Compiles an expression tree straight to x86-64 machine code (Linux only for now).
+
+   The generated function takes the variables array (indexed by atom, like ast_evaluate) and returns the
+   result in xmm0, so it can be called like any other function. Every value is an f64 in an SSE2 register:
+   a node's result goes in xmm<depth>, literals are read from a constant pool placed right after the code,
+   and variables and literals that are the right operand of an operator are used straight from memory.
+
+   The code is written into a fresh mapping which is then made executable and read only, it is never
+   writable and executable at the same time.
+
+   Only literals, variables, unary + and - and + - * / are supported. jit_compile returns false for
+   anything else (%, conditionals, strings, expressions more than 16 registers deep) and on other
+   platforms. Compiled_Expression takes care of falling back to the bytecode VM or the tree walk.
+**/
+
+typedef f64 (*Jit_Entry)(const f64 *variables);
+
+struct Jit_Function {
+    Jit_Entry entry;
+    void *memory;        // The mapping holding code and constants.
+    s64 memory_size;
+    s64 variable_count;  // variables passed to entry must have at least this many values.
+};
+
+bool jit_compile(Jit_Function *function, Ast_Tree *tree, Ast_Index root);
+void jit_free(Jit_Function *function);
+
+/**
+   An expression prepared to be evaluated many times, with the fastest method that supports it: the JIT,
+   the bytecode VM or walking the tree. The tree must stay alive if neither compiler could take it.
+**/
+
+enum Evaluation_Method : u8 {
+    EVALUATE_JIT,
+    EVALUATE_BYTECODE,
+    EVALUATE_TREE,
+};
+
+struct Compiled_Expression {
+    Evaluation_Method method;
+
+    Jit_Function jit;
+    Bytecode bytecode;
+
+    Ast_Tree *tree;
+    Ast_Index root;
+};
+
+void compiled_expression_init(Compiled_Expression *expression, Ast_Tree *tree, Ast_Index root);
+void compiled_expression_deinit(Compiled_Expression *expression);
+f64  compiled_expression_run(Compiled_Expression *expression, f64 *variables, s64 variable_count);
@@ -1,9 +1,13 @@
 #include "Lexer.h"
-#include "Hash.h"
 #include "Common.h"
+#include "Lexer_Simd.h"
+#include "Character_Class.h"
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h> // strtod
+#include <errno.h>
+#include <string.h> // memmove
 
 // @Note: Look into https://c9x.me/compile/ for backend stuff.
 
@@ -11,15 +15,15 @@ char lexer_peek_next_character(Lexer *lexer);
 
 // @Sync: lexer_keywords and lexer_token_table must be maintained in tandem.
 // Modifications in one must be made to the other.
-static const char *lexer_keywords[] = {
+static constexpr const char *lexer_keywords[] = {
     "const", "if", "else", "switch", "case", "default", "break", 
     "return", "while", "for", "goto", "continue", "struct", "NULL", 
     "enum", "union", "true", "false", "float", "int", "char", "void", "static", 
     "do", "f32", "f64", "s8", "s16", "s32", "s64", "u8", "u16", "u32", "u64",
-    "include", "main", NULL,
+    "include", "main",
 };
 
-static const Token_Type lexer_token_table[] { 
+static constexpr Token_Type lexer_token_table[] { 
     TOKEN_KEYWORD_CONST,
     TOKEN_KEYWORD_IF,
     TOKEN_KEYWORD_ELSE,
@@ -58,37 +62,112 @@ static const Token_Type lexer_token_table[] {
     TOKEN_KEYWORD_MAIN,
 };
 
+static_assert(sizeof(lexer_keywords) / sizeof(lexer_keywords[0]) == sizeof(lexer_token_table) / sizeof(lexer_token_table[0]),
+              "lexer_keywords and lexer_token_table are out of sync");
+
+const s32 KEYWORD_COUNT      = sizeof(lexer_token_table) / sizeof(lexer_token_table[0]);
+const u32 KEYWORD_TABLE_BITS = 7;
+const u32 KEYWORD_TABLE_SIZE = 1 << KEYWORD_TABLE_BITS;
+
+// Keywords are found with a perfect hash built at compile time. The hash only looks at the length and the
+// first and last characters. We try multipliers until every keyword lands in its own slot, so a lookup is
+// a single slot load and one memcmp to make sure it really is that keyword.
+struct Keyword_Slot { 
+    const char *name;  // NULL for empty slots.
+    u32 count;
+    Token_Type type;
+};
+
+struct Keyword_Table { 
+    u32 multiplier;
+    Keyword_Slot slots[KEYWORD_TABLE_SIZE];
+};
+
+constexpr u32 keyword_hash(const char *name, u32 count, u32 multiplier) { 
+    u32 key = (u32)(u8)name[0] | ((u32)(u8)name[count - 1] << 8) | (count << 16);
+    return (key * multiplier) >> (32 - KEYWORD_TABLE_BITS);
+}
+
+constexpr u32 constexpr_length(const char *string) { 
+    u32 count = 0;
+    while (string[count]) { ++count; }
+    return count;
+}
+
+constexpr Keyword_Table make_keyword_table() { 
+    for (u32 attempt = 0; attempt < 100000; ++attempt) { 
+        u32 multiplier = 0x9e3779b1 + attempt * 2;
+
+        Keyword_Table table = {};
+        bool collided = false;
+        for (s32 index = 0; index < KEYWORD_COUNT && !collided; ++index) { 
+            const char *name = lexer_keywords[index];
+            u32 count = constexpr_length(name);
+
+            Keyword_Slot &slot = table.slots[keyword_hash(name, count, multiplier)];
+            if (slot.name) { collided = true; break; }
+
+            slot.name  = name;
+            slot.count = count;
+            slot.type  = lexer_token_table[index];
+        }
+
+        if (!collided) { 
+            table.multiplier = multiplier;
+            return table;
+        }
+    }
+    return Keyword_Table{};
+}
+
+static constexpr Keyword_Table keyword_table = make_keyword_table();
+static_assert(keyword_table.multiplier != 0, "Could not find a perfect hash for the keywords, make the table bigger");
+
+// Returns the keyword's slot or NULL if the name isn't a keyword.
+const Keyword_Slot *find_keyword(char *name, u32 count) { 
+    const Keyword_Slot *slot = &keyword_table.slots[keyword_hash(name, count, keyword_table.multiplier)];
+    if (slot->count == count && memcmp(slot->name, name, count) == 0) { return slot; }
+    return NULL;
+}
+
 void ASSERT(bool expr) { 
     if (!expr) { 
         exit(1);
     }
 }
 
-// Pulled out to replace new with an allocator of some sort
-// Maybe Token Pool?
-Token *NEW_TOKEN(Token_Type token_type=Token_Type::TOKEN_INVALID) { 
-    Token *token = new Token;
+// Tokens are bump allocated out of the lexer's arena so they're packed next to each other
+// and freed in one go in lexer_deinit.
+Token *NEW_TOKEN(Lexer *lexer, Token_Type token_type=Token_Type::TOKEN_INVALID) { 
+    Token *token = arena_new<Token>(&lexer->token_arena);
+    *token = {};
     token->type = token_type;
     return token;
 }
 
+// Resets the token and stamps it with where it starts in the stream.
+void begin_token(Lexer *lexer, Token *token, Token_Type token_type) {
+    *token = {};
+    token->type = token_type;
+    token->position.line_start   = lexer->current_line_number;
+    token->position.column_start = lexer->current_column_number;
+    token->position.offset       = lexer->stream.cursor;
+}
+
 bool is_valid_keyword(char *string) { return true; }
 
-void lexer_report_error(const char *fmt, ...) {
+void lexer_report_error(Lexer *lexer, const char *fmt, ...) {
   va_list args;
   va_start(args, fmt); 
+  vsnprintf(lexer->error_message, sizeof(lexer->error_message), fmt, args);
+  va_end(args); 
+  if (lexer->error_jump) { longjmp(*lexer->error_jump, 1); }
   printf("\033[1;31m");
-  vprintf(fmt, args); 
+  printf("%s", lexer->error_message);
   printf("\033[0m");
-  va_end(args); 
   exit(1);
 }
 
-inline bool is_space(char c) {
-    if (c == ' ' || c == '\f' || c == '\n' || c == '\r' || c == '\t' || c == '\v') { return true; }
-    return false; 
-}
-
 void eat_character(Lexer *lexer) { 
     ASSERT(lexer && lexer->stream.cursor < lexer->stream.count);
     if (lexer->stream.data[lexer->stream.cursor] == '\n') {
@@ -103,7 +182,7 @@ void eat_character(Lexer *lexer) {
 
 s32 get_hex_digit(Lexer *lexer) { 
     ASSERT(lexer);
-    char c = lexer_peek_next_character(lexer);
+    char c = lexer->stream.data[lexer->stream.cursor];
     if      ((c >= 'a') && (c <= 'f')) { eat_character(lexer); return 10 + c - 'a'; } 
     else if ((c >= 'A') && (c <= 'F')) { eat_character(lexer); return 10 + c - 'A'; } 
     else if ((c >= '0') && (c <= '9')) { eat_character(lexer); return      c - '0'; } 
@@ -115,20 +194,19 @@ inline char char_to_lower(char c) {
 }
 
 inline bool is_digit(char c) {
-    return  ('0' <= c) && (c <= '9'); 
+    return character_class(c) & CHAR_DIGIT;
 }
 
 inline bool is_alpha(char c) {
-    if (c  >= 'a' && c <= 'z' || c >= 'A' && c <= 'Z') { return true; }
-    return false;
+    return character_class(c) & CHAR_ALPHA;
 }
 
 inline bool is_alpha_numeric(char c) {
-    return is_alpha(c) || is_digit(c);
+    return character_class(c) & (CHAR_ALPHA | CHAR_DIGIT);
 }
 
 inline bool is_hex_digit(char c) {
-    return (('0' <= c) && (c <= '9')) || (('a' <= char_to_lower(c)) && (char_to_lower(c) <= 'f')); 
+    return character_class(c) & CHAR_HEX_DIGIT;
 }
 
 bool is_digit(Lexer *lexer) { 
@@ -141,45 +219,42 @@ inline u32 str_len(const char *str) {
     return size;
 }
 
-void intern_keywords(Lexer *lexer) { 
-    ASSERT(lexer);
-
-    u16 index = 0;
-    const char **pointer = lexer_keywords;
-    while (*pointer != NULL) { 
-        // Hash the string keyword for fast lookups.
-        u32 hash = murmur_32((void *)*pointer, strlen(*pointer));
-        // Add the hash of the keyword to the corresponding token type
-        table_add(&lexer->keywords, hash, lexer_token_table[index]);
-        ++index;
-        ++pointer;
+// Moves the cursor to result->end and updates the line and column like calling eat_character
+// for every byte in between would have.
+void advance_past_skip(Lexer *lexer, Skip_Result *result) { 
+    if (result->newlines) { 
+        lexer->current_line_number  += result->newlines;
+        lexer->current_column_number = result->end - result->last_newline;
+    } else { 
+        lexer->current_column_number += result->end - lexer->stream.cursor;
     }
+    lexer->stream.cursor = result->end;
+}
+
+void skip(Lexer *lexer, Skip_Kind kind) { 
+    Skip_Result result = {};
+    skip_run(lexer->stream.data, lexer->stream.cursor, lexer->stream.count, kind, &result);
+    advance_past_skip(lexer, &result);
 }
 
 void eat_whitespace(Lexer *lexer) {
     ASSERT(lexer && lexer->stream.data);
-    while (is_space(lexer->stream.data[lexer->stream.cursor])) { 
-        eat_character(lexer);
-    }
+    skip(lexer, SKIP_SPACES);
 }
 
-void skip_line_comment(Lexer *lexer) { 
+bool skip_line_comment(Lexer *lexer) { 
     ASSERT(lexer && lexer->stream.data);
     if (lexer->stream.data[lexer->stream.cursor] == '/' && lexer->stream.data[lexer->stream.cursor + 1] == '/') { 
-        while (lexer->stream.data[lexer->stream.cursor] != '\n') {
-            eat_character(lexer); 
-        }
+        skip(lexer, SKIP_LINE);
 
-        ASSERT(lexer->stream.data[lexer->stream.cursor] == '\n');
-        // Eat the new line character
-        eat_character(lexer);
-
-        // eat any whitespaces after.
-        eat_whitespace(lexer);
+        // Eat the new line character, unless the comment ran into the end of the file.
+        if (lexer->stream.cursor < lexer->stream.count) { eat_character(lexer); }
+        return true;
     }
+    return false;
 }
 
-void skip_block_comment(Lexer *lexer) {
+bool skip_block_comment(Lexer *lexer) {
     ASSERT(lexer && lexer->stream.data);
     if (lexer->stream.data[lexer->stream.cursor] == '/' && lexer->stream.data[lexer->stream.cursor + 1] == '*') { 
         // eat '/'
@@ -187,8 +262,9 @@ void skip_block_comment(Lexer *lexer) {
         // eat '*'
         eat_character(lexer);
 
-        while (lexer->stream.data[lexer->stream.cursor] != '*' && lexer->stream.data[lexer->stream.cursor + 1] != '/') {
-            eat_character(lexer);
+        skip(lexer, SKIP_BLOCK);
+        if (lexer->stream.cursor >= lexer->stream.count) { 
+            lexer_report_error(lexer, "%s\n", "Failed to find closing */ for block comment");
         }
     
         ASSERT(lexer->stream.data[lexer->stream.cursor] == '*' && lexer->stream.data[lexer->stream.cursor + 1] == '/');
@@ -198,49 +274,62 @@ void skip_block_comment(Lexer *lexer) {
     
         // eat the '/'
         eat_character(lexer);
-
-        // eat any whitespaces after.
-        eat_whitespace(lexer);
+        return true;
     }
+    return false;
 }
 
-void update_fields_if_lexer_keyword(Lexer *lexer, Token *token) { 
-    ASSERT(lexer);
-
-    u32 hash = murmur_32((void *)token->ident_name, token->ident_count);
-    
-    auto *found = table_find_pointer(&lexer->keywords, hash);
-    if (found) { 
-        token->type = *found;
-    }
+// Skips everything up to the next token, there can be any number of comments in a row.
+void skip_whitespace_and_comments(Lexer *lexer) { 
+    do { 
+        eat_whitespace(lexer);
+    } while (skip_line_comment(lexer) || skip_block_comment(lexer));
 }
 
-void lexer_init(Lexer *lexer) {
+void lexer_init(Lexer *lexer, Interner *interner) {
     ASSERT(lexer);
-    table_init(&lexer->keywords, 0);
-    
-    // Intern all the keywords for amortized constant access in the lexer with a hash table.
-    intern_keywords(lexer);
+
+    // Room for a couple thousand tokens per block.
+    arena_init(&lexer->token_arena, 2048 * sizeof(Token));
     
     lexer->stream = {};
     lexer->current_line_number   = 1;
     lexer->current_column_number = 0;
     lexer->owns_input_memory     = false;
+    lexer->input_file            = {};
+
+    lexer->interner      = interner;
+    lexer->owns_interner = !interner;
+    if (lexer->owns_interner) { 
+        lexer->interner = new Interner;
+        interner_init(lexer->interner);
+    }
+
+    lexer->error_jump = NULL;
+    lexer->error_message[0] = '\0';
 }
 
 void lexer_deinit(Lexer *lexer) {
-    table_deinit(&lexer->keywords);
-    if (lexer->owns_input_memory && lexer->stream.data) { delete[] lexer->stream.data; }
+    arena_deinit(&lexer->token_arena);
+    if (lexer->owns_interner) { 
+        interner_deinit(lexer->interner);
+        delete lexer->interner;
+        lexer->interner      = NULL;
+        lexer->owns_interner = false;
+    }
+    if (lexer->owns_input_memory && lexer->input_file.data) { unmap_file(&lexer->input_file); }
     lexer->owns_input_memory = false;
 }
 
 void lexer_set_input_from_file(Lexer *lexer, char *file_name) {
     ASSERT(lexer);
  
-    s64 length = read_file(file_name, (void **)&lexer->stream.data);
-    ASSERT(length > 0);
+    if (!map_file(file_name, &lexer->input_file)) { 
+        lexer_report_error(lexer, "Could not open '%s'\n", file_name);
+    }
 
-    lexer->stream.count  = length; 
+    lexer->stream.data   = (char *)lexer->input_file.data;
+    lexer->stream.count  = lexer->input_file.size; 
     lexer->stream.cursor = 0;
 
     lexer->current_line_number   = 1; 
@@ -250,8 +339,10 @@ void lexer_set_input_from_file(Lexer *lexer, char *file_name) {
 }
 
 void lexer_set_input_from_memory(Lexer *lexer, char *_data) { 
-    ASSERT(lexer);
-    lexer->stream.data = _data;
+    ASSERT(lexer && _data);
+    lexer->stream.data   = _data;
+    lexer->stream.count  = strlen(_data);
+    lexer->stream.cursor = 0;
     lexer->current_line_number   = 1;
     lexer->current_column_number = 0;
 }
@@ -276,13 +367,11 @@ Token *lexer_peek_next_token(Lexer *lexer) {
     return token;
 }
 
-Token *scan_string_literal(Lexer *lexer) { 
+void scan_string_literal(Lexer *lexer, Token *token) { 
     ASSERT(lexer && lexer->stream.cursor < lexer->stream.count);
-    if (lexer->stream.data[lexer->stream.cursor] != '\"') { return NULL; }
+    if (lexer->stream.data[lexer->stream.cursor] != '\"') { return; }
 
-    Token *token = NEW_TOKEN(Token_Type::TOKEN_STRING);
-    token->position.line_start   = lexer->current_line_number;
-    token->position.column_start = lexer->current_column_number;
+    begin_token(lexer, token, Token_Type::TOKEN_STRING);
 
     token->string_value.data  = NULL;
     token->string_value.count = 0;
@@ -295,7 +384,7 @@ Token *scan_string_literal(Lexer *lexer) {
     if (lexer->stream.data[lexer->stream.cursor] == '\"') { 
         token->position.line_end   = lexer->current_line_number;
         token->position.column_end = lexer->current_column_number;
-        return token;
+        return;
     }
 
     // We need to allocate memory to hold the string in case we free the
@@ -306,7 +395,7 @@ Token *scan_string_literal(Lexer *lexer) {
 
     while (lexer->stream.data[lexer->stream.cursor] != '\"') { 
         if (lexer->stream.data[lexer->stream.cursor] == '\0') { 
-            lexer_report_error("%s\n", "Failed to find closing \" for string");
+            lexer_report_error(lexer, "%s\n", "Failed to find closing \" for string");
         }
         
         // Bump the string count
@@ -327,33 +416,32 @@ Token *scan_string_literal(Lexer *lexer) {
     
     // eat the closing string quote
     eat_character(lexer);
-
-    return token;
 }
 
-Token *scan_character_literal(Lexer *lexer) { 
+void scan_character_literal(Lexer *lexer, Token *token) { 
     ASSERT(lexer && lexer->stream.cursor < lexer->stream.count);
-    if (lexer->stream.data[lexer->stream.cursor] != '\'') { return NULL; }
+    if (lexer->stream.data[lexer->stream.cursor] != '\'') { return; }
     
-    Token *token = NEW_TOKEN(Token_Type::TOKEN_CHAR);
-    token->position.line_start   = lexer->current_line_number;
-    token->position.column_start = lexer->current_column_number;
+    begin_token(lexer, token, Token_Type::TOKEN_CHAR);
 
     //eat the opening character quote
     eat_character(lexer);
     
     if (lexer->stream.data[lexer->stream.cursor] == '\0') { 
-        lexer_report_error("%s\n", "Character quote missing");
+        lexer_report_error(lexer, "%s\n", "Character quote missing");
     } 
     
     if (lexer->stream.data[lexer->stream.cursor] == '\'') { 
-        lexer_report_error("%s\n", "Character cannot be empty");
+        lexer_report_error(lexer, "%s\n", "Character cannot be empty");
     }
     
     if (lexer->stream.data[lexer->stream.cursor] == '\\') { 
         eat_character(lexer);
         if (lexer->stream.data[lexer->stream.cursor] == 'n') { 
-            lexer_report_error("%s\n", "Character cannot contain a new line");
+            lexer_report_error(lexer, "%s\n", "Character cannot contain a new line");
+        }
+        if (lexer->stream.data[lexer->stream.cursor] == '\0') { 
+            lexer_report_error(lexer, "%s\n", "Character quote missing");
         }
     }
 
@@ -366,147 +454,437 @@ Token *scan_character_literal(Lexer *lexer) {
     token->position.line_end   = lexer->current_line_number;
     token->position.column_end = lexer->current_column_number;
 
-    ASSERT(lexer->stream.data[lexer->stream.cursor] == '\'');
+    if (lexer->stream.data[lexer->stream.cursor] != '\'') { 
+        lexer_report_error(lexer, "%s\n", "Character quote missing");
+    }
 
     // eat the closing character quote
     eat_character(lexer);
-
-    return token;
 }
 
-Token *scan_identifier(Lexer *lexer) { 
+void scan_identifier(Lexer *lexer, Token *token) { 
     ASSERT(lexer && lexer->stream.data);
-    ASSERT(is_alpha_numeric(lexer->stream.data[lexer->stream.cursor]) ||
-           lexer->stream.data[lexer->stream.cursor] == '_');
-
-    Token *token = NEW_TOKEN(Token_Type::TOKEN_IDENT);
-    token->position.line_start   = lexer->current_line_number;
-    token->position.column_start = lexer->current_column_number;
+    ASSERT(character_class(lexer->stream.data[lexer->stream.cursor]) & CHAR_IDENT_START);
 
-    token->ident_name = &lexer->stream.data[lexer->stream.cursor];
-    token->ident_count = 0;
+    begin_token(lexer, token, Token_Type::TOKEN_IDENT);
 
-    while (is_alpha_numeric(lexer->stream.data[lexer->stream.cursor]) ||
-           lexer->stream.data[lexer->stream.cursor] == '_') { 
-        // Bump the ident count
-        ++token->ident_count;
+    char *name = &lexer->stream.data[lexer->stream.cursor];
 
-        // eat the character
-        eat_character(lexer);
+    u64 end = identifier_run_end(lexer->stream.data, lexer->stream.cursor, lexer->stream.count);
+    u64 count = end - lexer->stream.cursor;
+    if (count > 0xffff) { 
+        lexer_report_error(lexer, "%s\n", "Identifier is too long");
     }
-    
-    char *ident_name = new char[token->ident_count + 1];
-    strncpy(ident_name, token->ident_name, token->ident_count);
-           
-    token->ident_name = ident_name;
-    token->ident_name[token->ident_count] = '\0';
-    
+    token->ident_count = (u16)count;
+
+    // Identifiers never contain a new line so only the column moves.
+    lexer->current_column_number += count;
+    lexer->stream.cursor          = end;
+
     token->position.line_end   = lexer->current_line_number;
     token->position.column_end = lexer->current_column_number;
 
-    // Now we need to check our intered keywords to see if this 
-    // is actually an identifier or a keyword
-    // If it is a keyword then we need to update the Token_Type;
-    update_fields_if_lexer_keyword(lexer, token);
+    // Keywords don't get interned, their name points at the keyword table.
+    const Keyword_Slot *keyword = find_keyword(name, (u32)count);
+    if (keyword) { 
+        token->type       = keyword->type;
+        token->ident_name = (char *)keyword->name;
+        return;
+    }
 
-    return token;
+    // Only the first occurrence of a name gets copied, after that we just get the atom back.
+    token->atom       = intern(lexer->interner, name, count);
+    token->ident_name = interner_get(lexer->interner, token->atom).data;
+}
+
+// True if all 8 bytes are '0' - '9'. Both the high nibble has to be 3 and adding 6 can't carry out of the low one.
+inline bool is_eight_digits(u64 chunk) { 
+    return ((chunk & 0xf0f0f0f0f0f0f0f0) == 0x3030303030303030) &&
+           (((chunk + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) == 0x3030303030303030);
+}
+
+// Converts 8 ascii digits loaded little endian (first digit in the low byte) in 3 multiplies.
+// Adjacent digits are combined into pairs, then pairs into groups of 4, then the two groups of 4.
+inline u64 parse_eight_digits(u64 chunk) { 
+    const u64 mask = 0x000000ff000000ff;
+    const u64 mul1 = 100 + (1000000ull << 32);
+    const u64 mul2 = 1   + (10000ull   << 32);
+
+    chunk -= 0x3030303030303030;
+    chunk  = (chunk * 10) + (chunk >> 8);
+    chunk  = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+    return chunk;
+}
+
+const u64 U64_MAX = 0xffffffffffffffff;
+
+// Accumulates the decimal digits starting at cursor onto *value and returns the offset after the last one.
+// Takes 8 digits at a time while it can. Sets *overflow if the value no longer fits in a u64, in which case
+// *value is garbage but the digits are still consumed.
+u64 parse_decimal_digits(char *data, u64 cursor, u64 count, u64 *value, bool *overflow) { 
+    u64 result = *value;
+
+    while (cursor + 8 <= count) { 
+        u64 chunk;
+        memcpy(&chunk, data + cursor, sizeof(chunk));
+        if (!is_eight_digits(chunk)) { break; }
+
+        u64 digits = parse_eight_digits(chunk);
+        if (result > (U64_MAX - digits) / 100000000) { *overflow = true; }
+        result = result * 100000000 + digits;
+        cursor += 8;
+    }
+
+    while (is_digit(data[cursor])) { 
+        u64 digit = data[cursor] - '0';
+        if (result > (U64_MAX - digit) / 10) { *overflow = true; }
+        result = result * 10 + digit;
+        ++cursor;
+    }
+
+    *value = result;
+    return cursor;
+}
+
+// Numbers never span lines so moving to the end of one only moves the column.
+void advance_within_line(Lexer *lexer, u64 end) { 
+    lexer->current_column_number += end - lexer->stream.cursor;
+    lexer->stream.cursor          = end;
+}
+
+void scan_hex_or_binary_literal(Lexer *lexer, Token *token) { 
+    // eat the '0'
+    eat_character(lexer);
+    char base = char_to_lower(lexer->stream.data[lexer->stream.cursor]);
+    // eat the 'x' or 'b'
+    eat_character(lexer);
+
+    u64 value  = 0;
+    s32 digits = 0;
+    bool overflow = false;
+
+    if (base == 'x') { 
+        s32 digit;
+        while ((digit = get_hex_digit(lexer)) >= 0) { 
+            if (value >> 60) { overflow = true; }
+            value = (value << 4) | digit;
+            ++digits;
+        }
+    } else { 
+        char c;
+        while ((c = lexer->stream.data[lexer->stream.cursor]) == '0' || c == '1') { 
+            if (value >> 63) { overflow = true; }
+            value = (value << 1) | (c - '0');
+            ++digits;
+            eat_character(lexer);
+        }
+    }
+
+    if (digits == 0) { 
+        lexer_report_error(lexer, "%s\n", base == 'x' ? "Hex literal has no digits" : "Binary literal has no digits");
+    }
+    if (overflow) { 
+        lexer_report_error(lexer, "%s\n", "Integer literal does not fit in 64 bits");
+    }
+
+    token->integer_value = value;
+}
+
+const f64 exact_powers_of_ten[] = { 
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Turns mantissa * 10^exponent into the nearest double. start and end delimit the literal's text.
+//
+// When the mantissa fits in the 53 bits of a double and 10^exponent is itself exactly representable
+// (up to 10^22) the result is a single correctly rounded multiply or divide. Everything else goes to strtod
+// which always rounds correctly.
+f64 decimal_to_f64(Lexer *lexer, char *start, char *end, u64 mantissa, s64 exponent, bool truncated) { 
+    if (!truncated) { 
+        if (mantissa == 0) { return 0.0; }
+        if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) { 
+            f64 value = (f64)mantissa;
+            if (exponent < 0) { return value / exact_powers_of_ten[-exponent]; }
+            return value * exact_powers_of_ten[exponent];
+        }
+    }
+
+    char  small_copy[64];
+    s64   count = end - start;
+    char *copy  = count < (s64)sizeof(small_copy) ? small_copy : new char[count + 1];
+    memcpy(copy, start, count);
+    copy[count] = '\0';
+
+    errno = 0;
+    f64 value = strtod(copy, NULL);
+    bool out_of_range = errno == ERANGE && (value > 1.0 || value < -1.0);
+
+    if (copy != small_copy) { delete[] copy; }
+
+    if (out_of_range) { 
+        lexer_report_error(lexer, "%s\n", "Float literal is too large");
+    }
+    return value;
 }
 
-Token *scan_numeric_literal(Lexer *lexer) { 
+void scan_numeric_literal(Lexer *lexer, Token *token) { 
     ASSERT(lexer && lexer->stream.data);
-    bool digit = is_digit(lexer) || (lexer->stream.data[lexer->stream.cursor] == '.');
+    char *data  = lexer->stream.data;
+    u64   count = lexer->stream.count;
+    u64   start = lexer->stream.cursor;
+
+    bool digit = is_digit(data[start]) || (data[start] == '.' && is_digit(data[start + 1]));
     if (!digit) { 
         ASSERT(false);
-        return NULL; 
+        return; 
     }
 
-    Token *token = NEW_TOKEN(Token_Type::TOKEN_INT);
-    token->position.line_start   = lexer->current_line_number;
-    token->position.column_start = lexer->current_column_number;
+    begin_token(lexer, token, Token_Type::TOKEN_INT);
 
-    // Scan the number as if it's just an integer.
-    u64 whole_number = 0;
-    while (lexer->stream.data[lexer->stream.cursor] >= '0' && 
-           lexer->stream.data[lexer->stream.cursor] <= '9') {
-        whole_number = whole_number * 10 + lexer->stream.data[lexer->stream.cursor] - '0';
-        eat_character(lexer);
-    }
-    
-    // If we encounter a '.' then this must be a float
-    // Scan the decimal value.
-    if (lexer->stream.data[lexer->stream.cursor] == '.') { 
-        token->type = Token_Type::TOKEN_FLOAT;
-        // eat the '.'
-        eat_character(lexer);
-        
-        f64 yyy = 0.1;
-        f64 fraction = 0.0;
-        while (lexer->stream.data[lexer->stream.cursor] >= '0' && 
-               lexer->stream.data[lexer->stream.cursor] <= '9') {
-            fraction += (lexer->stream.data[lexer->stream.cursor] - '0') * yyy;
-            eat_character(lexer);
-            yyy *= 0.1;
-        }
-        
-        // Put together the whole number plus the fraction part.
-        token->f64_value = (f64)whole_number + fraction;
+    char base = char_to_lower(data[start + 1]);
+    if (data[start] == '0' && (base == 'x' || base == 'b')) { 
+        scan_hex_or_binary_literal(lexer, token);
     } else { 
-        token->integer_value = whole_number;
+        u64  mantissa = 0;
+        bool overflow = false;
+        s64  exponent = 0;
+
+        u64 cursor = parse_decimal_digits(data, start, count, &mantissa, &overflow);
+
+        // If we encounter a '.' then this must be a float
+        if (data[cursor] == '.') { 
+            token->type = Token_Type::TOKEN_FLOAT;
+            u64 fraction_start = cursor + 1;
+            cursor = parse_decimal_digits(data, fraction_start, count, &mantissa, &overflow);
+            exponent -= (s64)(cursor - fraction_start);
+        }
+
+        char e = data[cursor];
+        if (e == 'e' || e == 'E') { 
+            token->type = Token_Type::TOKEN_FLOAT;
+            ++cursor;
+
+            bool negative = data[cursor] == '-';
+            if (data[cursor] == '-' || data[cursor] == '+') { ++cursor; }
+            if (!is_digit(data[cursor])) { 
+                advance_within_line(lexer, cursor);
+                lexer_report_error(lexer, "%s\n", "Exponent has no digits");
+            }
+
+            // Anything past a few hundred is out of range anyway, just don't let it wrap around.
+            s64 exponent_value = 0;
+            while (is_digit(data[cursor])) { 
+                if (exponent_value < 100000) { exponent_value = exponent_value * 10 + (data[cursor] - '0'); }
+                ++cursor;
+            }
+            exponent += negative ? -exponent_value : exponent_value;
+        }
+
+        // Past the literal before reporting anything, so an error leaves the cursor after it.
+        advance_within_line(lexer, cursor);
+
+        if (token->type == Token_Type::TOKEN_FLOAT) { 
+            token->f64_value = decimal_to_f64(lexer, data + start, data + cursor, mantissa, exponent, overflow);
+        } else { 
+            if (overflow) { 
+                lexer_report_error(lexer, "%s\n", "Integer literal does not fit in 64 bits");
+            }
+            token->integer_value = mantissa;
+        }
+    }
+
+    if (character_class(lexer->stream.data[lexer->stream.cursor]) & CHAR_IDENT) { 
+        lexer_report_error(lexer, "Invalid suffix '%c' on numeric literal\n", lexer->stream.data[lexer->stream.cursor]);
     }
 
     token->position.line_end   = lexer->current_line_number;
     token->position.column_end = lexer->current_column_number;
-
-    return token;
 }
 
-Token *lexer_get_token(Lexer *lexer) {
-    ASSERT(lexer && lexer->stream.data);
+void lexer_scan_token(Lexer *lexer, Token *token) {
+    ASSERT(lexer && lexer->stream.data && token);
 
-    // Skip all whitespaces.
-    eat_whitespace(lexer);
-    
-    // Skip all lines comments.
-    skip_line_comment(lexer);
+    // Skip all whitespaces and comments.
+    skip_whitespace_and_comments(lexer);
 
-    // Skip all block comments.
-    skip_block_comment(lexer);
+    // Identifiers (and keywords) are by far the most common tokens so they're checked first.
+    char c = lexer->stream.data[lexer->stream.cursor];
+    u8 flags = character_class(c);
+    if (flags & CHAR_IDENT_START) { 
+        scan_identifier(lexer, token);
+        return;
+    }
+    if ((flags & CHAR_DIGIT) || (c == '.' && is_digit(lexer->stream.data[lexer->stream.cursor + 1]))) { 
+        scan_numeric_literal(lexer, token);
+        return;
+    }
     
-    switch (lexer->stream.data[lexer->stream.cursor]) { 
+    switch (c) { 
         case '\0': { 
-            Token *token = NEW_TOKEN(Token_Type::TOKEN_EOF);
-            return token;
-        }
-        case '0': case '1': case '2': case '3': case '4': 
-        case '5': case '6': case '7': case '8': case '9': case '.': { 
-            return scan_numeric_literal(lexer);
+            begin_token(lexer, token, Token_Type::TOKEN_EOF);
+            return;
         }
         case '"': { 
-            return scan_string_literal(lexer);
+            scan_string_literal(lexer, token);
+            return;
         }
         case '\'': { 
-            return scan_character_literal(lexer);
-        }
-        case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': 
-        case 'H': case 'I': case 'J': case 'K': case 'L': case 'M': case 'N':
-        case 'O': case 'P': case 'Q': case 'R': case 'S': case 'T': case 'U': 
-        case 'V': case 'W': case 'X': case 'Y': case 'Z': case 'a': case 'b': 
-        case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': 
-        case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p': 
-        case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': 
-        case 'x': case 'y': case 'z': case '_': {
-            return scan_identifier(lexer);
+            scan_character_literal(lexer, token);
+            return;
         }
         default: {
-            Token *token = NEW_TOKEN((Token_Type)lexer->stream.data[lexer->stream.cursor]);
-            token->position.line_start   = lexer->current_line_number;
-            token->position.column_start = lexer->current_column_number;
+            begin_token(lexer, token, (Token_Type)(u8)lexer->stream.data[lexer->stream.cursor]);
 
             eat_character(lexer);
 
             token->position.line_end   = lexer->current_line_number;
             token->position.column_end = lexer->current_column_number;
-            return token;
+            return;
         }
     }
 }
+
+Token *lexer_get_token(Lexer *lexer) {
+    Token *token = NEW_TOKEN(lexer);
+    lexer_scan_token(lexer, token);
+    return token;
+}
+
+// Lexes the whole stream up front. The tokens are scanned into one scratch token and copied
+// straight into the buffer so nothing gets allocated out of the token arena.
+void lexer_tokenize_all(Lexer *lexer, Token_Buffer *buffer) { 
+    ASSERT(lexer && lexer->stream.data && buffer);
+
+    // Start at one token every 16 bytes and let the buffer double from there. A token takes more buffer than
+    // most tokens take source, so guessing high would reserve several times the size of the input up front.
+    if (buffer->capacity == 0) { token_buffer_init(buffer, lexer->stream.count / 16 + 64); }
+
+    Token token;
+    do { 
+        lexer_scan_token(lexer, &token);
+        token_buffer_add(buffer, &token);
+    } while (token.type != Token_Type::TOKEN_EOF);
+}
+
+static bool token_has_name(Token_Type type) { 
+    return type == Token_Type::TOKEN_IDENT ||
+           (type >= Token_Type::TOKEN_KEYWORD_CONST && type <= Token_Type::TOKEN_KEYWORD_MAIN);
+}
+
+void token_buffer_init(Token_Buffer *buffer, s64 capacity) { 
+    ASSERT(buffer && capacity >= 0);
+    *buffer = {};
+    if (capacity == 0) { return; }
+
+    buffer->capacity  = capacity;
+    buffer->types     = (Token_Type *)    malloc(capacity * sizeof(Token_Type));
+    buffer->offsets   = (u64 *)           malloc(capacity * sizeof(u64));
+    buffer->locations = (Token_Location *)malloc(capacity * sizeof(Token_Location));
+    buffer->payloads  = (Token_Payload *) malloc(capacity * sizeof(Token_Payload));
+    ASSERT(buffer->types && buffer->offsets && buffer->locations && buffer->payloads);
+}
+
+void token_buffer_deinit(Token_Buffer *buffer) { 
+    ASSERT(buffer);
+    free(buffer->types);
+    free(buffer->offsets);
+    free(buffer->locations);
+    free(buffer->payloads);
+    *buffer = {};
+}
+
+static void token_buffer_grow(Token_Buffer *buffer) { 
+    s64 capacity = buffer->capacity * 2;
+    if (capacity < 64) { capacity = 64; }
+
+    buffer->types     = (Token_Type *)    realloc(buffer->types,     capacity * sizeof(Token_Type));
+    buffer->offsets   = (u64 *)           realloc(buffer->offsets,   capacity * sizeof(u64));
+    buffer->locations = (Token_Location *)realloc(buffer->locations, capacity * sizeof(Token_Location));
+    buffer->payloads  = (Token_Payload *) realloc(buffer->payloads,  capacity * sizeof(Token_Payload));
+    ASSERT(buffer->types && buffer->offsets && buffer->locations && buffer->payloads);
+
+    buffer->capacity = capacity;
+}
+
+void token_buffer_add(Token_Buffer *buffer, Token *token) { 
+    ASSERT(buffer && token);
+    if (buffer->count >= buffer->capacity) { token_buffer_grow(buffer); }
+
+    s64 index = buffer->count++;
+    buffer->types[index]   = token->type;
+    buffer->offsets[index] = token->position.offset;
+    buffer->locations[index].line   = (u32)token->position.line_start;
+    buffer->locations[index].column = (u32)token->position.column_start;
+
+    Token_Payload *payload = &buffer->payloads[index];
+    if (token_has_name(token->type)) { 
+        payload->ident.name  = token->ident_name;
+        payload->ident.count = token->ident_count;
+        payload->ident.atom  = token->atom;
+    } else if (token->type == Token_Type::TOKEN_STRING) { 
+        payload->string_value.data  = token->string_value.data;
+        payload->string_value.count = token->string_value.count;
+    } else if (token->type == Token_Type::TOKEN_FLOAT) { 
+        payload->f64_value = token->f64_value;
+    } else if (token->type == Token_Type::TOKEN_CHAR) { 
+        payload->character_value = token->character_value;
+    } else { 
+        payload->integer_value = token->integer_value;
+    }
+}
+
+// Replaces the removed_count tokens starting at index with all of the tokens in inserted.
+void token_buffer_splice(Token_Buffer *buffer, s64 index, s64 removed_count, Token_Buffer *inserted) { 
+    ASSERT(buffer && inserted && index >= 0 && removed_count >= 0 && index + removed_count <= buffer->count);
+
+    s64 count = buffer->count - removed_count + inserted->count;
+    while (count > buffer->capacity) { token_buffer_grow(buffer); }
+
+    // Move everything after the removed tokens to where the inserted ones end.
+    s64 from = index + removed_count;
+    s64 to   = index + inserted->count;
+    s64 tail = buffer->count - from;
+    if (from != to) { 
+        memmove(buffer->types     + to, buffer->types     + from, tail * sizeof(Token_Type));
+        memmove(buffer->offsets   + to, buffer->offsets   + from, tail * sizeof(u64));
+        memmove(buffer->locations + to, buffer->locations + from, tail * sizeof(Token_Location));
+        memmove(buffer->payloads  + to, buffer->payloads  + from, tail * sizeof(Token_Payload));
+    }
+
+    if (inserted->count) { 
+        memcpy(buffer->types     + index, inserted->types,     inserted->count * sizeof(Token_Type));
+        memcpy(buffer->offsets   + index, inserted->offsets,   inserted->count * sizeof(u64));
+        memcpy(buffer->locations + index, inserted->locations, inserted->count * sizeof(Token_Location));
+        memcpy(buffer->payloads  + index, inserted->payloads,  inserted->count * sizeof(Token_Payload));
+    }
+
+    buffer->count = count;
+}
+
+// Rebuilds a Token from the buffer. Only the start of the position is filled in.
+void token_buffer_get(Token_Buffer *buffer, s64 index, Token *token) { 
+    ASSERT(buffer && token && index >= 0 && index < buffer->count);
+
+    *token = {};
+    token->type = buffer->types[index];
+    token->position.offset       = buffer->offsets[index];
+    token->position.line_start   = buffer->locations[index].line;
+    token->position.column_start = buffer->locations[index].column;
+
+    Token_Payload *payload = &buffer->payloads[index];
+    if (token_has_name(token->type)) { 
+        token->ident_name  = payload->ident.name;
+        token->ident_count = payload->ident.count;
+        token->atom        = payload->ident.atom;
+    } else if (token->type == Token_Type::TOKEN_STRING) { 
+        token->string_value.data  = payload->string_value.data;
+        token->string_value.count = payload->string_value.count;
+    } else if (token->type == Token_Type::TOKEN_FLOAT) { 
+        token->f64_value = payload->f64_value;
+    } else if (token->type == Token_Type::TOKEN_CHAR) { 
+        token->character_value = payload->character_value;
+    } else { 
+        token->integer_value = payload->integer_value;
+    }
+}
@@ -1,7 +1,11 @@
 #pragma once
 
 #include "Types.h"
-#include "Hash_Table.h"
+#include "Arena.h"
+#include "Common.h"
+#include "Interner.h"
+
+#include <setjmp.h>
 
 /**
    This lexer lexs on demand instead of doing it all it one shot.
@@ -108,6 +112,8 @@ struct Token_Position {
     u64 line_end;
     u64 column_start;
     u64 column_end;
+    // Byte offset of the first character of the token in the stream.
+    u64 offset;
 };
 
 struct Token { 
@@ -116,13 +122,17 @@ struct Token {
     Token_Position position;
 
     // Name of the identifier
-    // Kept as char so it's nul terminated when doing keyword lookups.
+    // Points at the interned copy so it's nul terminated and outlives the source. It lives as long as the
+    // lexer's interner, for a lexer with its own interner that's until lexer_deinit.
     char *ident_name;
     
     // The length of identifier name
     // So we don't have to do a bunch of strlens
     u16 ident_count;
 
+    // Interned name of identifiers, compare these instead of the names. ATOM_NONE for keywords.
+    Atom atom;
+
     // Holds the value of the type.
     union { 
         char character_value;
@@ -133,6 +143,34 @@ struct Token {
     };
 };
 
+// The value part of a token on its own so Token_Buffer can keep it in its own array.
+union Token_Payload { 
+    char character_value;
+    u64  integer_value;
+    f64  f64_value;
+    struct { char *data; u64 count; } string_value;
+    struct { char *name; u16 count; Atom atom; } ident;  // Identifiers and keywords.
+};
+
+// Where a token starts, kept next to the offset so errors can still point at a line after the source is gone.
+struct Token_Location { 
+    u32 line;
+    u32 column;
+};
+
+// Output of lexer_tokenize_all. The tokens are laid out as a structure of arrays so walking
+// the types (which is what the parser does the most) pulls in a cache line of nothing but types.
+// Only the start of each token is kept, not where it ends.
+struct Token_Buffer { 
+    s64 count;
+    s64 capacity;
+
+    Token_Type     *types;
+    u64            *offsets;    // Byte offset of each token in the stream.
+    Token_Location *locations;
+    Token_Payload  *payloads;
+};
+
 struct Stream { 
     // Where we are currently in the stream.
     u64 cursor;
@@ -150,17 +188,42 @@ struct Lexer {
     u64 current_column_number;
     
     bool owns_input_memory;
+
+    // Set when the input came from lexer_set_input_from_file, stream.data points into it.
+    Mapped_File input_file;
+
+    // Every token handed out by lexer_get_token lives here. They stay valid until lexer_deinit
+    // which frees them all at once.
+    Arena token_arena;
     
-    // Interned Keyword to length
-    Hash_Table<u32, Token_Type> keywords;
+    // Where identifier names get interned, the one given to lexer_init or else one of our own. An interner
+    // isn't thread safe, only share one between lexers which never run at the same time.
+    Interner *interner;
+    bool owns_interner;
+
+    // When set, an error isn't printed but kept in error_message and we jump here instead of exiting. The
+    // token being scanned is left half done and the cursor somewhere inside it.
+    jmp_buf *error_jump;
+
+    // The last error reported, so whoever set error_jump can report it themselves (on their own thread).
+    char error_message[256];
 };
 
 
 // Exported functions will be ones which start with lexer_###
-void lexer_init(Lexer *lexer);
+// Without an interner the lexer interns into its own, atoms are then only comparable between its own tokens.
+void lexer_init(Lexer *lexer, Interner *interner=NULL);
 void lexer_deinit(Lexer *lexer);
 void lexer_set_input_from_file(Lexer *lexer, char *file_name);
 void lexer_set_input_from_memory(Lexer *lexer, char *_data);
 char lexer_peek_next_character(Lexer *lexer);
 Token *lexer_peek_next_token(Lexer *lexer);
 Token *lexer_get_token(Lexer *lexer);
+void lexer_scan_token(Lexer *lexer, Token *token);
+void lexer_tokenize_all(Lexer *lexer, Token_Buffer *buffer);
+
+void token_buffer_init(Token_Buffer *buffer, s64 capacity=0);
+void token_buffer_deinit(Token_Buffer *buffer);
+void token_buffer_add(Token_Buffer *buffer, Token *token);
+void token_buffer_get(Token_Buffer *buffer, s64 index, Token *token);
+void token_buffer_splice(Token_Buffer *buffer, s64 index, s64 removed_count, Token_Buffer *inserted);
@@ -0,0 +1,104 @@
+#include "Lexer_Batch.h"
+
+#include <assert.h>
+#include <setjmp.h>
+#include <string.h> // memcpy
+
+#include <atomic>
+#include <thread>
+
+struct Lexer_Batch { 
+    char **file_names;
+    s32 file_count;
+    Lexed_File *results;
+
+    std::atomic<s32> next_file;  // Next file nobody has picked up yet.
+    std::atomic<s32> failed;     // Files which couldn't be opened or lexed.
+};
+
+// Lexing errors jump back here, on the worker's own thread, so one bad file only fails itself.
+static void lex_file(Lexed_File *file) { 
+    Lexer lexer;
+    lexer_init(&lexer, &file->interner);
+
+    jmp_buf error_jump;
+    lexer.error_jump = &error_jump;
+
+    if (setjmp(error_jump)) { 
+        file->failed       = true;
+        file->error_line   = lexer.current_line_number;
+        file->error_column = lexer.current_column_number;
+        memcpy(file->error_message, lexer.error_message, sizeof(file->error_message));
+
+        // The tokens before the error are kept, the TOKEN_INVALID keeps the buffer ending in a last token.
+        Token token = {};
+        token.type                  = Token_Type::TOKEN_INVALID;
+        token.position.line_start   = token.position.line_end   = lexer.current_line_number;
+        token.position.column_start = token.position.column_end = lexer.current_column_number;
+        token.position.offset       = lexer.stream.cursor;
+        token_buffer_add(&file->tokens, &token);
+    } else { 
+        lexer_set_input_from_file(&lexer, file->file_name);
+        lexer_tokenize_all(&lexer, &file->tokens);
+    }
+
+    // The tokens don't point into the source so it can be unmapped right away.
+    lexer_deinit(&lexer);
+}
+
+static void lex_files_worker(Lexer_Batch *batch) { 
+    while (1) { 
+        s32 index = batch->next_file.fetch_add(1, std::memory_order_relaxed);
+        if (index >= batch->file_count) { return; }
+
+        Lexed_File *file = &batch->results[index];
+        file->file_name        = batch->file_names[index];
+        file->failed           = false;
+        file->error_message[0] = '\0';
+        file->error_line       = 0;
+        file->error_column     = 0;
+        interner_init(&file->interner);
+        token_buffer_init(&file->tokens);
+
+        lex_file(file);
+        if (file->failed) { batch->failed.fetch_add(1, std::memory_order_relaxed); }
+    }
+}
+
+s32 lexer_tokenize_files(char **file_names, s32 file_count, s32 thread_count, Lexed_File *results) { 
+    assert(file_names && results && file_count >= 0 && thread_count >= 0);
+
+    if (thread_count == 0) { thread_count = (s32)std::thread::hardware_concurrency(); }
+    if (thread_count > file_count) { thread_count = file_count; }
+    if (thread_count < 1) { thread_count = 1; }
+
+    Lexer_Batch batch;
+    batch.file_names = file_names;
+    batch.file_count = file_count;
+    batch.results    = results;
+    batch.next_file.store(0);
+    batch.failed.store(0);
+
+    // The calling thread works too, so we only start thread_count - 1 extra threads.
+    std::thread *workers = new std::thread[thread_count - 1];
+    for (s32 i = 0; i < thread_count - 1; ++i) { 
+        workers[i] = std::thread(lex_files_worker, &batch);
+    }
+
+    lex_files_worker(&batch);
+
+    for (s32 i = 0; i < thread_count - 1; ++i) { 
+        workers[i].join();
+    }
+    delete[] workers;
+
+    return batch.failed.load();
+}
+
+void lexed_files_deinit(Lexed_File *results, s32 file_count) { 
+    assert(results && file_count >= 0);
+    for (s32 i = 0; i < file_count; ++i) { 
+        token_buffer_deinit(&results[i].tokens);
+        interner_deinit(&results[i].interner);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Types.h"
+#include "Lexer.h"
+#include "Interner.h"
+
+/**
+   Lexes a whole list of files at once, spread over a number of worker threads.
+
+   Every worker has its own Lexer (and so its own token arena) and the files are handed out one at a time
+   from a shared counter, so a few big files don't leave the other workers idle. Each file gets its own
+   Interner so no two threads ever touch the same one, which means atoms are only comparable between
+   tokens of the same file.
+
+   The results come back in the same order as the file names no matter which worker lexed which file.
+
+   A file which can't be opened or doesn't lex doesn't stop the others. The lexer's error jumps back to the
+   worker, which marks the file failed with the message and where it happened, and goes on with the next one.
+**/
+
+struct Lexed_File { 
+    char *file_name;
+    Interner interner;    // Where this file's identifiers were interned.
+    Token_Buffer tokens;  // Ends with TOKEN_EOF, or with a TOKEN_INVALID at the error if the file failed.
+
+    bool failed;
+    char error_message[256];
+    u64 error_line;
+    u64 error_column;
+};
+
+// thread_count of 0 uses one thread per core. results must have room for file_count entries. Returns how
+// many of the files failed, see Lexed_File::failed.
+s32 lexer_tokenize_files(char **file_names, s32 file_count, s32 thread_count, Lexed_File *results);
+void lexed_files_deinit(Lexed_File *results, s32 file_count);
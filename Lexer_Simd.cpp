@@ -0,0 +1,195 @@
+#include "Lexer_Simd.h"
+#include "Character_Class.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define LEXER_SIMD 1
+#include <immintrin.h>
+#endif
+
+inline bool skip_stops_at(char *data, u64 index, Skip_Kind kind) {
+    char c = data[index];
+    switch (kind) {
+        case SKIP_SPACES: return !(character_class(c) & CHAR_SPACE);
+        case SKIP_LINE:   return c == '\n';
+        case SKIP_BLOCK:  return c == '*' && data[index + 1] == '/';
+    }
+    return true;
+}
+
+void skip_run_scalar(char *data, u64 start, u64 count, Skip_Kind kind, Skip_Result *result) {
+    u64 cursor = start;
+    for (; cursor < count; ++cursor) {
+        if (skip_stops_at(data, cursor, kind)) { break; }
+        if (data[cursor] == '\n') {
+            ++result->newlines;
+            result->last_newline = cursor;
+        }
+    }
+    result->end = cursor;
+}
+
+u64 identifier_run_end_scalar(char *data, u64 start, u64 count) {
+    u64 cursor = start;
+    while (cursor < count && (character_class(data[cursor]) & CHAR_IDENT)) { ++cursor; }
+    return cursor;
+}
+
+#if LEXER_SIMD
+
+// Adds the newlines of one block (bit i set means data[base + i] is a '\n').
+inline void count_newlines(Skip_Result *result, u64 base, u32 newline_mask) {
+    if (!newline_mask) { return; }
+    result->newlines    += __builtin_popcount(newline_mask);
+    result->last_newline = base + 31 - __builtin_clz(newline_mask);
+}
+
+// Bytes 0x09 - 0x0d and ' '.
+inline u32 sse2_space_mask(__m128i bytes) {
+    __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8('\r' - '\t')), shifted);
+    __m128i space   = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+    return (u32)_mm_movemask_epi8(_mm_or_si128(control, space));
+}
+
+static void skip_run_sse2(char *data, u64 start, u64 count, Skip_Kind kind, Skip_Result *result) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i star    = _mm_set1_epi8('*');
+    const __m128i slash   = _mm_set1_epi8('/');
+
+    u64 cursor = start;
+    // The "*/" check also loads the byte after the block, which is at most data[count] (the nul).
+    while (cursor + 16 <= count) {
+        __m128i bytes = _mm_loadu_si128((__m128i *)(data + cursor));
+        u32 newlines  = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+
+        u32 stop = 0;
+        switch (kind) {
+            case SKIP_SPACES: stop = ~sse2_space_mask(bytes) & 0xffff; break;
+            case SKIP_LINE:   stop = newlines; break;
+            case SKIP_BLOCK: {
+                __m128i next = _mm_loadu_si128((__m128i *)(data + cursor + 1));
+                stop = (u32)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bytes, star), _mm_cmpeq_epi8(next, slash)));
+            } break;
+        }
+
+        if (stop) {
+            u32 index = __builtin_ctz(stop);
+            count_newlines(result, cursor, newlines & ((1u << index) - 1));
+            result->end = cursor + index;
+            return;
+        }
+
+        count_newlines(result, cursor, newlines);
+        cursor += 16;
+    }
+
+    skip_run_scalar(data, cursor, count, kind, result);
+}
+
+#define AVX2_TARGET __attribute__((target("avx2,popcnt,lzcnt,bmi")))
+
+AVX2_TARGET inline void avx2_count_newlines(Skip_Result *result, u64 base, u32 newline_mask) {
+    if (!newline_mask) { return; }
+    result->newlines    += __builtin_popcount(newline_mask);
+    result->last_newline = base + 31 - __builtin_clz(newline_mask);
+}
+
+AVX2_TARGET inline u32 avx2_space_mask(__m256i bytes) {
+    __m256i shifted = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8('\r' - '\t')), shifted);
+    __m256i space   = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+    return (u32)_mm256_movemask_epi8(_mm256_or_si256(control, space));
+}
+
+AVX2_TARGET static void skip_run_avx2(char *data, u64 start, u64 count, Skip_Kind kind, Skip_Result *result) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i star    = _mm256_set1_epi8('*');
+    const __m256i slash   = _mm256_set1_epi8('/');
+
+    u64 cursor = start;
+    while (cursor + 32 <= count) {
+        __m256i bytes = _mm256_loadu_si256((__m256i *)(data + cursor));
+        u32 newlines  = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline));
+
+        u32 stop = 0;
+        switch (kind) {
+            case SKIP_SPACES: stop = ~avx2_space_mask(bytes); break;
+            case SKIP_LINE:   stop = newlines; break;
+            case SKIP_BLOCK: {
+                __m256i next = _mm256_loadu_si256((__m256i *)(data + cursor + 1));
+                stop = (u32)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(bytes, star), _mm256_cmpeq_epi8(next, slash)));
+            } break;
+        }
+
+        if (stop) {
+            u32 index = __builtin_ctz(stop);
+            avx2_count_newlines(result, cursor, newlines & ((1u << index) - 1));
+            result->end = cursor + index;
+            return;
+        }
+
+        avx2_count_newlines(result, cursor, newlines);
+        cursor += 32;
+    }
+
+    // Finish off with 16 byte steps and then the scalar loop.
+    skip_run_sse2(data, cursor, count, kind, result);
+}
+
+// Most identifiers are shorter than 16 bytes so SSE2 is wide enough to find the end in one step,
+// we don't bother with an AVX2 version.
+u64 identifier_run_end(char *data, u64 start, u64 count) {
+    const __m128i case_bit    = _mm_set1_epi8(0x20);
+    const __m128i letter_span = _mm_set1_epi8('z' - 'a');
+    const __m128i digit_span  = _mm_set1_epi8('9' - '0');
+    const __m128i underscore  = _mm_set1_epi8('_');
+
+    u64 cursor = start;
+    while (cursor + 16 <= count) {
+        __m128i bytes = _mm_loadu_si128((__m128i *)(data + cursor));
+
+        // Folding the case bit in maps both A-Z and a-z to a-z, nothing else lands in that range.
+        __m128i letter = _mm_sub_epi8(_mm_or_si128(bytes, case_bit), _mm_set1_epi8('a'));
+        __m128i digit  = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+
+        // Unsigned x <= span is min(x, span) == x.
+        __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, letter_span), letter);
+        __m128i is_digit  = _mm_cmpeq_epi8(_mm_min_epu8(digit,  digit_span),  digit);
+        __m128i is_under  = _mm_cmpeq_epi8(bytes, underscore);
+
+        u32 ident = (u32)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(is_letter, is_digit), is_under));
+        u32 stop  = ~ident & 0xffff;
+        if (stop) { return cursor + __builtin_ctz(stop); }
+
+        cursor += 16;
+    }
+
+    return identifier_run_end_scalar(data, cursor, count);
+}
+
+#else
+
+u64 identifier_run_end(char *data, u64 start, u64 count) {
+    return identifier_run_end_scalar(data, start, count);
+}
+
+#endif // LEXER_SIMD
+
+typedef void (*Skip_Run_Function)(char *, u64, u64, Skip_Kind, Skip_Result *);
+
+static Skip_Run_Function select_skip_run() {
+#if LEXER_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) { return skip_run_avx2; }
+    return skip_run_sse2;
+#else
+    return skip_run_scalar;
+#endif
+}
+
+static const Skip_Run_Function selected_skip_run = select_skip_run();
+
+// Skips from start until whatever kind says to stop at. result should be zeroed by the caller.
+void skip_run(char *data, u64 start, u64 count, Skip_Kind kind, Skip_Result *result) {
+    selected_skip_run(data, start, count, kind, result);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Types.h"
+
+/**
+   Vectorized scanning loops used by the lexer.
+
+   Each loop looks at 16 (SSE2) or 32 (AVX2) bytes per step instead of one. The widest version the CPU
+   supports is picked once at startup, on anything that isn't x86-64 (or isn't compiled with gcc/clang)
+   we fall back to a scalar loop which gives the same results.
+
+   The loops only ever load bytes in [start, count], so they are safe on any nul terminated buffer
+   no matter how much padding follows it.
+**/
+
+enum Skip_Kind : u8 {
+    SKIP_SPACES, // Stop at the first byte which isn't whitespace.
+    SKIP_LINE,   // Stop at the next '\n'.
+    SKIP_BLOCK,  // Stop at the next "*/".
+};
+
+struct Skip_Result {
+    u64 end;          // Offset we stopped at. count if we never found what we were looking for.
+    u64 newlines;     // Number of '\n' we went over.
+    u64 last_newline; // Offset of the last '\n' we went over, only valid if newlines isn't 0.
+};
+
+void skip_run(char *data, u64 start, u64 count, Skip_Kind kind, Skip_Result *result);
+void skip_run_scalar(char *data, u64 start, u64 count, Skip_Kind kind, Skip_Result *result);
+
+// Returns the offset one past the last identifier character (a-z A-Z 0-9 _) starting at start.
+u64 identifier_run_end(char *data, u64 start, u64 count);
+u64 identifier_run_end_scalar(char *data, u64 start, u64 count);
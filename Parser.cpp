@@ -1,66 +1,288 @@
 #include "Parser.h"
 #include "Ast.h"
+#include "Ast_Fold.h"
 #include "Lexer.h"
+#include "Token_Ring.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h> // exit
+
+void parser_report_error(Parser *parser, const char *fmt, ...);
 
 void parser_init(Parser *parser, Lexer *_lexer) { 
     assert(parser && _lexer);
+    *parser = {};
     parser->lexer = _lexer;
     parser->current_token = NULL;
+    ast_tree_init(&parser->tree);
+}
+
+void parser_init_from_tokens(Parser *parser, Token_Buffer *_tokens) { 
+    assert(parser && _tokens && _tokens->count > 0);
+    *parser = {};
+    parser->tokens        = _tokens;
+    parser->token_cursor  = 0;
+    parser->current_token = NULL;
+    ast_tree_init(&parser->tree);
+}
+
+// Starts lexing on a background thread. The lexer must not be touched until parser_deinit.
+void parser_init_pipelined(Parser *parser, Lexer *_lexer) { 
+    assert(parser && _lexer);
+    *parser = {};
+    parser->lexer = _lexer;
+    parser->ring  = new Token_Ring;
+    ast_tree_init(&parser->tree);
+    token_ring_start(parser->ring, _lexer);
 }
 
 void parser_deinit(Parser *parser) { 
     assert(parser);
+    if (parser->ring) { 
+        token_ring_stop(parser->ring);
+        delete parser->ring;
+        parser->ring  = NULL;
+        parser->batch = NULL;
+    }
+    ast_tree_deinit(&parser->tree);
     parser->current_token = NULL;
 }
 
-f64 parse_factor(Parser *parser) { 
-    assert(parser);
-    assert(parser->current_token->type == Token_Type::TOKEN_INT ||
-           parser->current_token->type == Token_Type::TOKEN_FLOAT);
+void parser_advance_from_ring(Parser *parser) { 
+    Token_Batch *batch = parser->batch;
+    if (batch && parser->batch_cursor >= batch->count) { 
+        // The lexer thread is done after the batch holding the last token, stay on that token.
+        Token *last = &batch->tokens[batch->count - 1];
+        if (last->type == Token_Type::TOKEN_EOF || last->type == Token_Type::TOKEN_INVALID) { 
+            parser->current_token = last;
+            return;
+        }
+
+        token_ring_release(parser->ring);
+        batch = NULL;
+    }
 
-    if (parser->current_token->type == Token_Type::TOKEN_INT) { 
-        return parser->current_token->integer_value;
+    if (!batch) { 
+        // We stop at the batch holding the last token, the lexer thread is never done before we get there.
+        batch = token_ring_pop(parser->ring);
+        assert(batch);
+        parser->batch        = batch;
+        parser->batch_cursor = 0;
     }
-    if (parser->current_token->type == Token_Type::TOKEN_FLOAT) { 
-        return parser->current_token->f64_value;
+
+    parser->current_token = &batch->tokens[parser->batch_cursor++];
+
+    // Lexing stopped on an error, it gets reported here on the parser's thread.
+    if (parser->current_token->type == Token_Type::TOKEN_INVALID && parser->ring->failed) { 
+        parser_report_error(parser, "%s", parser->lexer->error_message);
     }
 }
 
-f64 parse_expression(Parser *parser) {
-    parser->current_token = lexer_get_token(parser->lexer);
-
-    f64 first = parse_factor(parser);
-    
-    parser->current_token = lexer_get_token(parser->lexer);
-    
-    while (parser->current_token->type != Token_Type::TOKEN_EOF) { 
-        while (parser->current_token->type == '-') { 
-            parser->current_token = lexer_get_token(parser->lexer);
-            f64 second = parse_factor(parser);
-            first = first - second;
+void parser_advance(Parser *parser) { 
+    if (parser->ring) { 
+        parser_advance_from_ring(parser);
+        return;
+    }
+
+    if (!parser->tokens) { 
+        parser->current_token = lexer_get_token(parser->lexer);
+        return;
+    }
+
+    // Stay on the last token (TOKEN_EOF) once we've run off the end of the buffer.
+    s64 index = parser->token_cursor;
+    if (index >= parser->tokens->count) { index = parser->tokens->count - 1; }
+    else { ++parser->token_cursor; }
+
+    token_buffer_get(parser->tokens, index, &parser->token_storage);
+    parser->current_token = &parser->token_storage;
+}
+
+void parser_report_error(Parser *parser, const char *fmt, ...) {
+    Token *token = parser->current_token;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(parser->error_message, sizeof(parser->error_message), fmt, args);
+    va_end(args);
+    if (parser->error_jump) { longjmp(*parser->error_jump, 1); }
+    printf("\033[1;31m");
+    printf("%llu:%llu: ", (unsigned long long)token->position.line_start, (unsigned long long)token->position.column_start);
+    printf("%s", parser->error_message);
+    printf("\033[0m");
+    exit(1);
+}
+
+/**
+   Expressions are parsed with precedence climbing (a Pratt parser).
+
+   Every infix operator has a left and a right binding power. parse_expression keeps folding operators into
+   the left hand side as long as they bind tighter than minimum_power, and parses each right hand side with
+   the operator's right power as the new minimum. Making the right power one higher than the left power
+   makes an operator left associative. Adding an operator is adding a row to the table.
+**/
+
+struct Binding_Power {
+    u8 left;  // 0 means the token isn't an infix operator.
+    u8 right;
+};
+
+struct Binding_Power_Table {
+    Binding_Power infix[Token_Type::TOKEN_INVALID + 1];
+};
+
+const u8 PREFIX_BINDING_POWER = 50;
+
+// Every '(', prefix operator and ?: goes one parse_expression deeper. Input nested deeper than this is an
+// error rather than a stack overflow, on any thread's stack.
+const s32 PARSER_MAX_DEPTH = 1000;
+
+constexpr Binding_Power_Table make_binding_power_table() {
+    Binding_Power_Table table = {};
+    table.infix['?'] = {2, 2};  // condition ? then : else, right associative.
+    table.infix['+'] = {10, 11};
+    table.infix['-'] = {10, 11};
+    table.infix['*'] = {20, 21};
+    table.infix['/'] = {20, 21};
+    table.infix['%'] = {20, 21};
+    return table;
+}
+
+static constexpr Binding_Power_Table binding_powers = make_binding_power_table();
+
+Ast_Index parse_expression(Parser *parser, u8 minimum_power);
+
+static constexpr Ast_Kind binary_kind(s32 op) {
+    switch (op) {
+        case '+': return AST_ADD;
+        case '-': return AST_SUBTRACT;
+        case '*': return AST_MULTIPLY;
+        case '/': return AST_DIVIDE;
+        case '%': return AST_MODULO;
+    }
+    return AST_NONE;
+}
+
+// Literals, identifiers, parentheses and prefix operators. Leaves current_token on the token after them.
+Ast_Index parse_prefix(Parser *parser) {
+    Token *token = parser->current_token;
+    Ast_Tree *tree = &parser->tree;
+
+    switch ((s32)token->type) {
+        case Token_Type::TOKEN_INT: {
+            Ast_Index literal = ast_add_int(tree, token->integer_value);
+            parser_advance(parser);
+            return literal;
         }
-        while (parser->current_token->type == '+') { 
-            parser->current_token = lexer_get_token(parser->lexer);
-            f64 second = parse_factor(parser);
-            first = first + second;
+        case Token_Type::TOKEN_FLOAT: {
+            Ast_Index literal = ast_add_float(tree, token->f64_value);
+            parser_advance(parser);
+            return literal;
         }
-        while (parser->current_token->type == '*') { 
-            parser->current_token = lexer_get_token(parser->lexer);
-            f64 second = parse_factor(parser);
-            first = first * second;
+        case Token_Type::TOKEN_KEYWORD_TRUE:
+        case Token_Type::TOKEN_KEYWORD_FALSE: {
+            Ast_Index literal = ast_add_bool(tree, token->type == Token_Type::TOKEN_KEYWORD_TRUE);
+            parser_advance(parser);
+            return literal;
         }
-        while (parser->current_token->type == '/') { 
-            parser->current_token = lexer_get_token(parser->lexer);
-            f64 second = parse_factor(parser);
-            first = first / second;
+        case Token_Type::TOKEN_STRING: {
+            Ast_Index literal = ast_add_string(tree, token->string_value.data, token->string_value.count);
+            parser_advance(parser);
+            return literal;
+        }
+        case Token_Type::TOKEN_IDENT: {
+            Ast_Index identifier = ast_add_identifier(tree, token->atom, token->ident_name, token->ident_count);
+            parser_advance(parser);
+            return identifier;
+        }
+        case '(': {
+            parser_advance(parser);
+            Ast_Index expression = parse_expression(parser, 0);
+            if (parser->current_token->type != ')') { parser_report_error(parser, "Expected ')'\n"); }
+            parser_advance(parser);
+            return expression;
+        }
+        case '-':
+        case '+': {
+            Ast_Kind kind = token->type == '-' ? AST_NEGATE : AST_PLUS;
+            parser_advance(parser);
+            // The operand goes in first, nodes are added in post-order.
+            Ast_Index operand = parse_expression(parser, PREFIX_BINDING_POWER);
+            return ast_add_unary(tree, kind, operand);
+        }
+        default: break;
+    }
+
+    parser_report_error(parser, "Expected an expression\n");
+    return AST_NULL;
+}
+
+Ast_Index parse_expression(Parser *parser, u8 minimum_power) {
+    if (++parser->depth > PARSER_MAX_DEPTH) { parser_report_error(parser, "The expression is nested too deeply\n"); }
+    Ast_Index left = parse_prefix(parser);
+
+    while (1) {
+        Token_Type op = parser->current_token->type;
+        if (op < 0 || op > Token_Type::TOKEN_INVALID) { break; }
+
+        Binding_Power power = binding_powers.infix[op];
+        if (!power.left || power.left < minimum_power) { break; }
+
+        parser_advance(parser);
+
+        if (op == '?') {
+            Ast_Index then = parse_expression(parser, 0);
+            if (parser->current_token->type != ':') { parser_report_error(parser, "Expected ':'\n"); }
+            parser_advance(parser);
+
+            Ast_Index otherwise = parse_expression(parser, power.right);
+            left = ast_add_conditional(&parser->tree, left, then, otherwise);
+            continue;
+        }
+
+        Ast_Index right = parse_expression(parser, power.right);
+        left = ast_add_binary(&parser->tree, binary_kind(op), left, right);
+    }
+
+    --parser->depth;
+    return left;
+}
+
+// Parses the whole input as one expression and returns its root in parser->tree.
+Ast_Index parser_parse_expression(Parser *parser) {
+    assert(parser && (parser->lexer || parser->tokens));
+    parser->depth = 0;
+    parser_advance(parser);
+
+    Ast_Index expression = parse_expression(parser, 0);
+    if (parser->current_token->type != Token_Type::TOKEN_EOF) { parser_report_error(parser, "Expected the end of the expression\n"); }
+    return expression;
+}
+
+// Parses one expression out of the Token_Buffer, starting at token first_token. It has to be followed by a ';'
+// or the end of the input, end_token_return gets the index of that token. Returns AST_NULL if the expression
+// is empty (first_token is already the ';' or the end).
+Ast_Index parser_parse_expression_at(Parser *parser, s64 first_token, s64 *end_token_return) {
+    assert(parser && parser->tokens && end_token_return);
+    assert(first_token >= 0 && first_token < parser->tokens->count);
+    parser->token_cursor = first_token;
+    parser->depth = 0;
+    parser_advance(parser);
+
+    Ast_Index expression = AST_NULL;
+    if (parser->current_token->type != ';' && parser->current_token->type != Token_Type::TOKEN_EOF) {
+        expression = parse_expression(parser, 0);
+        if (parser->current_token->type != ';' && parser->current_token->type != Token_Type::TOKEN_EOF) {
+            parser_report_error(parser, "Expected ';' or the end of the input\n");
         }
-        parser->current_token = lexer_get_token(parser->lexer);
     }
-    return first;
-        
+
+    *end_token_return = parser->token_cursor - 1;
+    return expression;
 }
 
-f64 parser_parse(Parser *parser) { 
-   assert(parser && parser->lexer);
-   return parse_expression(parser);
+f64 parser_parse(Parser *parser) {
+    Ast_Index root = parser_parse_expression(parser);
+    root = ast_fold_constants(&parser->tree, root);
+    return ast_evaluate(&parser->tree, root);
 }
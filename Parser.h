@@ -1,16 +1,46 @@
 #pragma once 
 
 #include "Types.h"
+#include "Ast.h"
+#include "Lexer.h"
 
-struct Ast;
-struct Token;
-struct Lexer;
+struct Token_Ring;
+struct Token_Batch;
 
 struct Parser { 
     Lexer *lexer;
     Token *current_token;
+
+    // When parsing from a Token_Buffer filled by lexer_tokenize_all these are set instead of lexer.
+    // current_token then points at token_storage which is refilled from the buffer on every advance.
+    Token_Buffer *tokens;
+    s64 token_cursor;
+    Token token_storage;
+
+    // Pipelined mode, the lexer runs on its own thread and we pull whole batches out of the ring.
+    // current_token points straight into the batch.
+    Token_Ring  *ring;
+    Token_Batch *batch;
+    s32 batch_cursor;
+
+    // Every node we build goes in here, it lives until parser_deinit.
+    Ast_Tree tree;
+
+    // How many parse_expression calls deep we are, see PARSER_MAX_DEPTH.
+    s32 depth;
+
+    // When set, an error isn't printed but kept in error_message and we jump here instead of exiting,
+    // current_token is the token it's at. Nodes built for the expression being parsed stay in the tree, unused.
+    jmp_buf *error_jump;
+
+    // The last error reported, without the position.
+    char error_message[256];
 };
 
 void parser_init(Parser *parser, Lexer *lexer);
+void parser_init_from_tokens(Parser *parser, Token_Buffer *tokens);
+void parser_init_pipelined(Parser *parser, Lexer *lexer);
 void parser_deinit(Parser *parser);
+Ast_Index parser_parse_expression(Parser *parser);
+Ast_Index parser_parse_expression_at(Parser *parser, s64 first_token, s64 *end_token_return);
 f64 parser_parse(Parser *parser);
@@ -0,0 +1,254 @@
+#pragma once
+
+#include "Types.h"
+#include "Hash.h"
+#include "Hash_Table.h"
+
+#include <assert.h>
+#include <string.h> // memset
+#include <stdlib.h> // malloc
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SWISS_TABLE_SSE2 1
+#endif
+
+/**
+
+   A variant of Hash_Table modelled after Abseil's "Swiss table" (flat_hash_map).
+
+   Next to the entries we keep a separate array with one control byte per slot. A control byte is either
+   SWISS_EMPTY, SWISS_DELETED, or the low 7 bits of the hash of the key living in that slot. Probing looks
+   at 16 control bytes at a time: one SSE2 compare against the 7 hash bits and a movemask gives us every
+   slot in the group that could hold the key, so we only ever touch an entry when its 7 bits match
+   (1 in 128 for a key that isn't there). A miss usually only costs loading a single 16 byte group.
+
+   Groups are probed linearly from the slot picked by the upper hash bits. A group can start at any slot,
+   so the first 16 control bytes are mirrored after the end of the array and a group load never has to wrap.
+
+   Removing leaves a SWISS_DELETED tombstone which table_add reuses. Tombstones count against the load
+   factor, once we hit it with a lot of them we rebuild the table at the same size instead of growing.
+
+   The API is the same as Hash_Table's.
+
+**/
+
+const u8 SWISS_EMPTY   = 0x80;
+const u8 SWISS_DELETED = 0xfe;
+const s32 SWISS_GROUP_SIZE = 16;
+
+template <typename Key_Type, typename Value_Type, typename Traits = Hash_Traits<Key_Type>>
+struct Swiss_Table {
+    s32 table_size;       // Number of slots. A power of 2 and at least SWISS_GROUP_SIZE.
+    s32 items;            // The number of live items in the table.
+    s32 tombstones;       // The number of SWISS_DELETED slots.
+    s32 resize_threshold; // items + tombstones allowed before we rebuild.
+
+    const int MIN_SIZE            = 32;
+    const int LOAD_FACTOR_PERCENT = 87;
+
+    struct Entry {
+        Key_Type    key;
+        Value_Type  value;
+    };
+
+    u8    *controls;  // table_size + SWISS_GROUP_SIZE bytes.
+    Entry *entries;
+};
+
+// Bit i is set if controls[i] == value.
+inline u32 swiss_group_match(u8 *controls, u8 value) {
+#if SWISS_TABLE_SSE2
+    __m128i group = _mm_loadu_si128((__m128i *)controls);
+    return (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)value)));
+#else
+    u32 mask = 0;
+    for (s32 i = 0; i < SWISS_GROUP_SIZE; ++i) { if (controls[i] == value) { mask |= 1u << i; } }
+    return mask;
+#endif
+}
+
+// Bit i is set if controls[i] is SWISS_EMPTY or SWISS_DELETED, those are the only ones with the high bit set.
+inline u32 swiss_group_match_free(u8 *controls) {
+#if SWISS_TABLE_SSE2
+    __m128i group = _mm_loadu_si128((__m128i *)controls);
+    return (u32)_mm_movemask_epi8(group);
+#else
+    u32 mask = 0;
+    for (s32 i = 0; i < SWISS_GROUP_SIZE; ++i) { if (controls[i] & 0x80) { mask |= 1u << i; } }
+    return mask;
+#endif
+}
+
+inline u32 swiss_lowest_bit(u32 mask) {
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    u32 index = 0;
+    while (!(mask & 1)) { mask >>= 1; ++index; }
+    return index;
+#endif
+}
+
+inline u8  swiss_h2(u32 hash) { return (u8)(hash & 0x7f); }
+inline u32 swiss_h1(u32 hash) { return hash >> 7; }
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void swiss_set_control(Swiss_Table <Key_Type, Value_Type, Traits> *table, u32 index, u8 control) {
+    table->controls[index] = control;
+    // Keep the mirrored copy of the first group in sync.
+    if (index < SWISS_GROUP_SIZE) { table->controls[table->table_size + index] = control; }
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_init(Swiss_Table <Key_Type, Value_Type, Traits> *table, s64 _table_size=0) {
+    if (_table_size < table->MIN_SIZE) { _table_size = table->MIN_SIZE; }
+
+    table->table_size = next_power_of_two(_table_size);
+    table->items      = 0;
+    table->tombstones = 0;
+
+    table->controls = (u8 *)malloc(table->table_size + SWISS_GROUP_SIZE);
+    table->entries  = (typename Swiss_Table <Key_Type, Value_Type, Traits>::Entry *) malloc(table->table_size * sizeof(typename Swiss_Table <Key_Type, Value_Type, Traits>::Entry));
+    assert(table->controls && table->entries);
+
+    memset(table->controls, SWISS_EMPTY, table->table_size + SWISS_GROUP_SIZE);
+
+    table->resize_threshold = (table->table_size * table->LOAD_FACTOR_PERCENT) / 100;
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_deinit(Swiss_Table <Key_Type, Value_Type, Traits> *table) {
+    free(table->controls);
+    free(table->entries);
+}
+
+// Finds a free slot for a key with the given hash, the caller makes sure there is one.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline u32 swiss_find_free_slot(Swiss_Table <Key_Type, Value_Type, Traits> *table, u32 hash) {
+    u32 mask  = table->table_size - 1;
+    u32 index = swiss_h1(hash) & mask;
+
+    while (1) {
+        u32 free_slots = swiss_group_match_free(&table->controls[index]);
+        if (free_slots) { return (index + swiss_lowest_bit(free_slots)) & mask; }
+        index = (index + SWISS_GROUP_SIZE) & mask;
+    }
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void swiss_rebuild(Swiss_Table <Key_Type, Value_Type, Traits> *table, s32 new_table_size) {
+    u8   *old_controls = table->controls;
+    auto *old_entries  = table->entries;
+    s32   old_size     = table->table_size;
+
+    table_init(table, new_table_size);
+
+    for (s32 i = 0; i < old_size; ++i) {
+        if (old_controls[i] & 0x80) { continue; }
+
+        auto *entry = &old_entries[i];
+        u32 hash  = Traits::hash(entry->key);
+        u32 index = swiss_find_free_slot(table, hash);
+
+        swiss_set_control(table, index, swiss_h2(hash));
+        table->entries[index] = *entry;
+        table->items++;
+    }
+
+    free(old_controls);
+    free(old_entries);
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_expand(Swiss_Table <Key_Type, Value_Type, Traits> *table) {
+    // If a good chunk of what's filling the table is tombstones just clean them out, otherwise grow.
+    if (table->tombstones > table->table_size / 8) {
+        swiss_rebuild(table, table->table_size);
+    } else {
+        swiss_rebuild(table, table->table_size * 2);
+    }
+}
+
+// Makes sure count items fit without the table growing.
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_reserve(Swiss_Table <Key_Type, Value_Type, Traits> *table, s64 count) {
+    s64 needed = table->table_size;
+    while ((needed * table->LOAD_FACTOR_PERCENT) / 100 < count + table->tombstones) { needed *= 2; }
+
+    if (needed > table->table_size) { swiss_rebuild(table, (s32)needed); }
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline s64 swiss_find_index(Swiss_Table <Key_Type, Value_Type, Traits> *table, Key_Type key) {
+    if (!table->table_size) { return -1; }
+
+    u32 hash  = Traits::hash(key);
+    u8  h2    = swiss_h2(hash);
+    u32 mask  = table->table_size - 1;
+    u32 index = swiss_h1(hash) & mask;
+
+    while (1) {
+        u8 *group = &table->controls[index];
+
+        u32 candidates = swiss_group_match(group, h2);
+        while (candidates) {
+            u32 slot = (index + swiss_lowest_bit(candidates)) & mask;
+            if (Traits::equal(table->entries[slot].key, key)) { return slot; }
+            candidates &= candidates - 1;
+        }
+
+        // An empty slot in the group means the key would have been put there, so it isn't in the table.
+        if (swiss_group_match(group, SWISS_EMPTY)) { return -1; }
+
+        index = (index + SWISS_GROUP_SIZE) & mask;
+    }
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline bool table_remove(Swiss_Table <Key_Type, Value_Type, Traits> *table, Key_Type key) {
+    s64 index = swiss_find_index(table, key);
+    if (index < 0) { return false; }
+
+    swiss_set_control(table, (u32)index, SWISS_DELETED);
+    --table->items;
+    ++table->tombstones;
+    return true;
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_add(Swiss_Table <Key_Type, Value_Type, Traits> *table, Key_Type key, Value_Type value) {
+    if (table->items + table->tombstones >= table->resize_threshold) { table_expand(table); }
+
+    u32 hash  = Traits::hash(key);
+    u32 index = swiss_find_free_slot(table, hash);
+
+    if (table->controls[index] == SWISS_DELETED) { --table->tombstones; }
+
+    swiss_set_control(table, index, swiss_h2(hash));
+    table->entries[index].key   = key;
+    table->entries[index].value = value;
+    table->items++;
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline Value_Type *table_find_pointer(Swiss_Table <Key_Type, Value_Type, Traits> *table, Key_Type key) {
+    s64 index = swiss_find_index(table, key);
+    if (index < 0) { return NULL; }
+    return &table->entries[index].value;
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline bool table_find(Swiss_Table <Key_Type, Value_Type, Traits> *table, Key_Type key) {
+    return table_find_pointer(table, key) != NULL;
+}
+
+template <typename Key_Type, typename Value_Type, typename Traits>
+inline void table_set(Swiss_Table <Key_Type, Value_Type, Traits> *table, Key_Type key, Value_Type new_value) {
+    Value_Type *old_value = table_find_pointer(table, key);
+    if (old_value) {
+        *old_value = new_value;
+    } else {
+        table_add(table, key, new_value);
+    }
+}
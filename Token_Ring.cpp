@@ -0,0 +1,113 @@
+#include "Token_Ring.h"
+
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h> // malloc, free
+
+static bool is_last_token(Token *token) { 
+    return token->type == Token_Type::TOKEN_EOF || token->type == Token_Type::TOKEN_INVALID;
+}
+
+static void token_ring_lex(Token_Ring *ring) { 
+    while (!ring->stop.load(std::memory_order_relaxed)) { 
+        u32 tail = ring->tail.load(std::memory_order_relaxed);
+
+        // Back off while the ring is full.
+        while (tail - ring->head.load(std::memory_order_acquire) == TOKEN_RING_BATCHES) { 
+            if (ring->stop.load(std::memory_order_relaxed)) { return; }
+            std::this_thread::yield();
+        }
+
+        Token_Batch *batch = &ring->batches[tail & (TOKEN_RING_BATCHES - 1)];
+        batch->count = 0;
+
+        bool done = false;
+        while (batch->count < TOKEN_BATCH_SIZE) { 
+            Token *token = &batch->tokens[batch->count++];
+            lexer_scan_token(ring->lexer, token);
+            if (is_last_token(token)) { done = true; break; }
+        }
+
+        // Publish the batch. The release pairs with the acquire in token_ring_pop.
+        ring->tail.store(tail + 1, std::memory_order_release);
+
+        if (done) { return; }
+    }
+}
+
+static void token_ring_produce(Token_Ring *ring) { 
+    Lexer *lexer = ring->lexer;
+
+    // Lexing errors come back here, on this thread, instead of exiting.
+    jmp_buf error_jump;
+    lexer->error_jump = &error_jump;
+
+    if (setjmp(error_jump)) { 
+        // The batch being filled hasn't been published yet so it's still ours. Its last token is the one the
+        // lexer gave up on, it becomes the TOKEN_INVALID ending the stream.
+        u32 tail = ring->tail.load(std::memory_order_relaxed);
+        Token_Batch *batch = &ring->batches[tail & (TOKEN_RING_BATCHES - 1)];
+        assert(batch->count > 0);
+
+        Token *token = &batch->tokens[batch->count - 1];
+        *token = {};
+        token->type = Token_Type::TOKEN_INVALID;
+        token->position.line_start   = token->position.line_end   = lexer->current_line_number;
+        token->position.column_start = token->position.column_end = lexer->current_column_number;
+        token->position.offset       = lexer->stream.cursor;
+
+        ring->failed = true;
+        ring->tail.store(tail + 1, std::memory_order_release);
+    } else { 
+        token_ring_lex(ring);
+    }
+
+    lexer->error_jump = NULL;
+    ring->done.store(true, std::memory_order_release);
+}
+
+void token_ring_start(Token_Ring *ring, Lexer *lexer) { 
+    assert(ring && lexer && lexer->stream.data);
+    static_assert((TOKEN_RING_BATCHES & (TOKEN_RING_BATCHES - 1)) == 0, "TOKEN_RING_BATCHES must be a power of 2");
+
+    ring->lexer   = lexer;
+    ring->batches = (Token_Batch *)malloc(TOKEN_RING_BATCHES * sizeof(Token_Batch));
+    assert(ring->batches);
+
+    ring->head.store(0);
+    ring->tail.store(0);
+    ring->stop.store(false);
+    ring->done.store(false);
+    ring->failed = false;
+
+    ring->thread = std::thread(token_ring_produce, ring);
+}
+
+void token_ring_stop(Token_Ring *ring) { 
+    assert(ring);
+    ring->stop.store(true);
+    if (ring->thread.joinable()) { ring->thread.join(); }
+
+    free(ring->batches);
+    ring->batches = NULL;
+}
+
+// Blocks until the lexer thread has published a batch. The batch stays valid until token_ring_release.
+// Returns NULL once the lexer thread is gone and every batch it published has been popped.
+Token_Batch *token_ring_pop(Token_Ring *ring) { 
+    u32 head = ring->head.load(std::memory_order_relaxed);
+    while (ring->tail.load(std::memory_order_acquire) == head) { 
+        // done is only set after the last tail bump, so look at tail once more after seeing it.
+        if (ring->done.load(std::memory_order_acquire) && ring->tail.load(std::memory_order_acquire) == head) { 
+            return NULL;
+        }
+        std::this_thread::yield();
+    }
+    return &ring->batches[head & (TOKEN_RING_BATCHES - 1)];
+}
+
+// Hands the batch returned by token_ring_pop back to the lexer thread.
+void token_ring_release(Token_Ring *ring) { 
+    u32 head = ring->head.load(std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Types.h"
+#include "Lexer.h"
+
+#include <atomic>
+#include <thread>
+
+/**
+   Runs a lexer on its own thread and hands the tokens over to a single consumer (the parser).
+
+   The lexer thread fills whole batches of tokens in place inside a fixed ring of batches and publishes
+   a batch by bumping tail. The consumer reads the batch at head and bumps head once it's done with it.
+   There is exactly one producer and one consumer so the two indices are all the synchronization we need,
+   no locks. When the ring is full the lexer thread waits for the parser to catch up.
+
+   The lexer thread stops on its own after it has published the batch holding TOKEN_EOF (or TOKEN_INVALID).
+   token_ring_stop can be called at any time and will make it bail out early.
+
+   A lexing error doesn't exit. The lexer jumps back to the lexer thread, which publishes what it has with
+   a TOKEN_INVALID at the error as the last token and sets failed. The message is in the lexer's
+   error_message, for the consumer to report on its own thread.
+**/
+
+const s32 TOKEN_BATCH_SIZE   = 256;
+const u32 TOKEN_RING_BATCHES = 32;  // Must be a power of 2.
+
+struct Token_Batch { 
+    s32 count;
+    Token tokens[TOKEN_BATCH_SIZE];
+};
+
+struct Token_Ring { 
+    Lexer *lexer;
+    Token_Batch *batches;
+
+    // Both only ever count up, the slot is the index masked by TOKEN_RING_BATCHES - 1.
+    // Kept on separate cache lines so the two threads don't fight over one line.
+    alignas(64) std::atomic<u32> head;  // Written by the consumer.
+    alignas(64) std::atomic<u32> tail;  // Written by the producer.
+
+    std::atomic<bool> stop;
+    std::atomic<bool> done;    // Set by the lexer thread when it returns, after its last tail bump.
+    bool failed;               // Set before the last batch is published if lexing stopped on an error.
+    std::thread thread;
+};
+
+void token_ring_start(Token_Ring *ring, Lexer *lexer);
+void token_ring_stop(Token_Ring *ring);
+Token_Batch *token_ring_pop(Token_Ring *ring);
+void token_ring_release(Token_Ring *ring);
@@ -0,0 +1,298 @@
+/**
+   Microbenchmarks for the hash tables, the hashes and the expression evaluators. Not part of the front end, build it on its own from the
+   repository root:
+
+       g++ -std=c++17 -O2 -pthread -I. bench/bench.cpp Lexer.cpp Lexer_Simd.cpp Lexer_Batch.cpp Token_Ring.cpp Parser.cpp Interner.cpp Ast.cpp Ast_Fold.cpp Bytecode.cpp Arena.cpp Common.cpp -o bench
+
+   Run it with no arguments for everything or with the name of one section:
+
+     tables  Hash_Table against Swiss_Table, hits and misses at 50-90% load.
+     churn   Hash_Table under remove/add churn, the cost per operation and the longest probe should stay
+             flat. Build with -DHASH_TABLE_STATS to also get the average probe length of its lookups.
+     batch   table_find_batch against a loop of table_find_pointer on a table bigger than the LLC.
+     hash    hash_64 against murmur_32 for short keys and a large buffer.
+     eval    Parsing and evaluating every time against ast_evaluate and bytecode_run.
+
+   Every number is the best of a few runs.
+**/
+
+#include "Types.h"
+#include "Hash.h"
+#include "Hash_Table.h"
+#include "Swiss_Table.h"
+#include "Parser.h"
+#include "Bytecode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+const s32 BENCH_RUNS = 3;
+
+// Keeps the compiler from throwing away the work being timed.
+static volatile u64 bench_sink;
+
+static u64 bench_random_state = 0x2545f4914f6cdd1dull;
+
+static u64 bench_random() {
+    bench_random_state ^= bench_random_state >> 12;
+    bench_random_state ^= bench_random_state << 25;
+    bench_random_state ^= bench_random_state >> 27;
+    return bench_random_state * 0x2545f4914f6cdd1dull;
+}
+
+// Nanoseconds per operation of the fastest of BENCH_RUNS calls to work(), which does operations of them.
+template <typename Work>
+static f64 bench_ns(s64 operations, Work work) {
+    f64 best = 0;
+    for (s32 run = 0; run < BENCH_RUNS; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        auto end = std::chrono::steady_clock::now();
+
+        f64 ns = std::chrono::duration<f64, std::nano>(end - start).count() / operations;
+        if (run == 0 || ns < best) { best = ns; }
+    }
+    return best;
+}
+
+static bool wants(const char *section, int argc, char **argv) {
+    return argc < 2 || strcmp(argv[1], section) == 0;
+}
+
+static void bench_tables() {
+    const s32 slots   = 1 << 20;
+    const s64 lookups = 1 << 22;
+    const s32 loads[] = {50, 70, 85, 90};
+
+    printf("tables, %d slots, ns per lookup:\n", slots);
+    for (s32 load : loads) {
+        s64 count = (s64)slots * load / 100;
+        u64 *keys = (u64 *)malloc(count * sizeof(u64));
+        for (s64 i = 0; i < count; ++i) { keys[i] = bench_random(); }
+
+        // Hash_Table grows at 70% and Swiss_Table at 87%, move the thresholds out of the way so the load
+        // stays where we put it.
+        Hash_Table<u64, u64> linear;
+        table_init(&linear, slots);
+        linear.resize_threshold = linear.table_size;
+        for (s64 i = 0; i < count; ++i) { table_add(&linear, keys[i], (u64)i); }
+
+        Swiss_Table<u64, u64> swiss;
+        table_init(&swiss, slots);
+        swiss.resize_threshold = swiss.table_size;
+        for (s64 i = 0; i < count; ++i) { table_add(&swiss, keys[i], (u64)i); }
+
+        f64 linear_hit = bench_ns(lookups, [&] {
+            u64 sum = 0;
+            for (s64 i = 0; i < lookups; ++i) { sum += *table_find_pointer(&linear, keys[(i * 7919) % count]); }
+            bench_sink = sum;
+        });
+        f64 swiss_hit = bench_ns(lookups, [&] {
+            u64 sum = 0;
+            for (s64 i = 0; i < lookups; ++i) { sum += *table_find_pointer(&swiss, keys[(i * 7919) % count]); }
+            bench_sink = sum;
+        });
+        f64 linear_miss = bench_ns(lookups, [&] {
+            u64 found = 0;
+            for (s64 i = 0; i < lookups; ++i) { found += table_find_pointer(&linear, keys[i % count] + 1) != NULL; }
+            bench_sink = found;
+        });
+        f64 swiss_miss = bench_ns(lookups, [&] {
+            u64 found = 0;
+            for (s64 i = 0; i < lookups; ++i) { found += table_find_pointer(&swiss, keys[i % count] + 1) != NULL; }
+            bench_sink = found;
+        });
+
+        printf("  load %d%%: hit  Hash_Table %6.1f  Swiss_Table %6.1f\n", load, linear_hit, swiss_hit);
+        printf("            miss Hash_Table %6.1f  Swiss_Table %6.1f\n", linear_miss, swiss_miss);
+
+        table_deinit(&linear);
+        table_deinit(&swiss);
+        free(keys);
+    }
+}
+
+// A lookup for a missing key walks to the end of the run of full slots it lands in, so the longest one it
+// can take is the longest run plus the empty slot ending it.
+static s64 longest_missing_probe(Hash_Table<u64, u64> *table) {
+    s64 longest = 0;
+    s64 run     = 0;
+    for (s32 i = 0; i < 2 * table->table_size; ++i) {
+        // Twice around so a run wrapping past the end is counted whole.
+        if (!table->entries[i & (table->table_size - 1)].hash) { run = 0; continue; }
+        if (++run > longest) { longest = run; }
+    }
+    return longest + 1;
+}
+
+#ifdef HASH_TABLE_STATS
+// Average of one of the Hash_Table_Stats histograms. Everything past the last bucket was counted in it, so
+// this is a little low if there were many very long probes.
+static f64 average_probe(s64 *buckets, s64 total) {
+    s64 sum = 0;
+    for (s32 i = 0; i < HASH_TABLE_PROBE_BUCKETS; ++i) { sum += buckets[i] * (i + 1); }
+    return total ? (f64)sum / total : 0;
+}
+#endif
+
+static void bench_churn() {
+    const s64 live   = 1 << 16;
+    const s32 rounds = 1000;
+
+    // Like scopes being pushed and popped: every round removes a slice of the keys and adds new ones.
+    Hash_Table<u64, u64> table;
+    table_init(&table);
+    u64 *keys = (u64 *)malloc(live * sizeof(u64));
+    for (s64 i = 0; i < live; ++i) { keys[i] = bench_random(); table_add(&table, keys[i], (u64)i); }
+
+    printf("churn, %lld live keys, ns per remove + add + missing lookup and probe lengths of missing lookups:\n", (long long)live);
+    const s64 slice = live / 16;
+    for (s32 round = 1; round <= rounds; ++round) {
+        s64 first = (round * slice) % live;
+#ifdef HASH_TABLE_STATS
+        table.stats = {};
+#endif
+        f64 ns = bench_ns(slice, [&] {
+            for (s64 i = first; i < first + slice; ++i) {
+                table_remove(&table, keys[i]);
+                keys[i] = bench_random();
+                table_add(&table, keys[i], (u64)i);
+                bench_sink = table_find_pointer(&table, keys[i] ^ 1) != NULL;
+            }
+        });
+        if (round == 1 || round == 10 || round == 100 || round == rounds) {
+            printf("  round %4d: %6.1f (table_size %d), longest %lld", round, ns, table.table_size,
+                   (long long)longest_missing_probe(&table));
+#ifdef HASH_TABLE_STATS
+            printf(", average %.2f", average_probe(table.stats.miss_probes, table.stats.misses));
+#endif
+            printf("\n");
+        }
+    }
+
+    table_deinit(&table);
+    free(keys);
+}
+
+static void bench_batch() {
+    const s64 count = 1 << 23;
+
+    Hash_Table<u64, u64> table;
+    table_init(&table);
+    u64 *keys = (u64 *)malloc(count * sizeof(u64));
+    for (s64 i = 0; i < count; ++i) { keys[i] = bench_random(); table_add(&table, keys[i], (u64)i); }
+
+    u64 *queries = (u64 *)malloc(count * sizeof(u64));
+    for (s64 i = 0; i < count; ++i) { queries[i] = keys[bench_random() % count]; }
+    u64 **results = (u64 **)malloc(count * sizeof(u64 *));
+
+    f64 single = bench_ns(count, [&] {
+        for (s64 i = 0; i < count; ++i) { results[i] = table_find_pointer(&table, queries[i]); }
+        bench_sink = (u64)results[count - 1];
+    });
+    f64 batched = bench_ns(count, [&] {
+        table_find_batch(&table, queries, count, results);
+        bench_sink = (u64)results[count - 1];
+    });
+
+    printf("batch, %lld keys in %lld MB: table_find_pointer %.1f ns, table_find_batch %.1f ns\n", (long long)count,
+           (long long)(table.table_size * sizeof(*table.entries) >> 20), single, batched);
+
+    table_deinit(&table);
+    free(keys);
+    free(queries);
+    free(results);
+}
+
+static void bench_hash() {
+    const s32 lengths[] = {1, 4, 8, 16, 32, 64};
+    const s64 hashes    = 1 << 22;
+
+    u8 *buffer = (u8 *)malloc(1 << 24);
+    for (s64 i = 0; i < (1 << 24); ++i) { buffer[i] = (u8)bench_random(); }
+
+    printf("hash, ns per hash:\n");
+    for (s32 length : lengths) {
+        // Walk the buffer so the keys aren't always the same bytes.
+        f64 murmur = bench_ns(hashes, [&] {
+            u64 sum = 0;
+            for (s64 i = 0; i < hashes; ++i) { sum += murmur_32(buffer + (i & 0xffff), length); }
+            bench_sink = sum;
+        });
+        f64 wide = bench_ns(hashes, [&] {
+            u64 sum = 0;
+            for (s64 i = 0; i < hashes; ++i) { sum += hash_64(buffer + (i & 0xffff), length); }
+            bench_sink = sum;
+        });
+        printf("  %2d bytes: murmur_32 %5.2f  hash_64 %5.2f\n", length, murmur, wide);
+    }
+
+    f64 murmur = bench_ns(1 << 24, [&] { bench_sink = murmur_32(buffer, 1 << 24); });
+    f64 wide   = bench_ns(1 << 24, [&] { bench_sink = hash_64(buffer, 1 << 24); });
+    printf("  16 MB:    murmur_32 %5.2f GB/s  hash_64 %5.2f GB/s\n", 1 / murmur, 1 / wide);
+
+    free(buffer);
+}
+
+static void bench_eval() {
+    static char expression[] = "(a * 2.5 + b / 3 - c * c) * (a - b) + -c / 7";
+    const s64 parses      = 200000;
+    const s64 evaluations = 10000000;
+
+    f64 variables[256];
+    for (s32 i = 0; i < 256; ++i) { variables[i] = i * 0.25; }
+
+    f64 parse = bench_ns(parses, [&] {
+        f64 sum = 0;
+        for (s64 i = 0; i < parses; ++i) {
+            Lexer lexer;
+            lexer_init(&lexer);
+            lexer_set_input_from_memory(&lexer, expression);
+            Parser parser;
+            parser_init(&parser, &lexer);
+            sum += ast_evaluate(&parser.tree, parser_parse_expression(&parser), variables, 256);
+            parser_deinit(&parser);
+            lexer_deinit(&lexer);
+        }
+        bench_sink = (u64)sum;
+    });
+
+    Lexer lexer;
+    lexer_init(&lexer);
+    lexer_set_input_from_memory(&lexer, expression);
+    Parser parser;
+    parser_init(&parser, &lexer);
+    Ast_Index root = parser_parse_expression(&parser);
+
+    Bytecode program;
+    if (!bytecode_compile(&program, &parser.tree, root)) { printf("eval: bytecode_compile failed\n"); exit(1); }
+
+    f64 tree = bench_ns(evaluations, [&] {
+        f64 sum = 0;
+        for (s64 i = 0; i < evaluations; ++i) { variables[1] = (f64)i; sum += ast_evaluate(&parser.tree, root, variables, 256); }
+        bench_sink = (u64)sum;
+    });
+    f64 vm = bench_ns(evaluations, [&] {
+        f64 sum = 0;
+        for (s64 i = 0; i < evaluations; ++i) { variables[1] = (f64)i; sum += bytecode_run(&program, variables, 256); }
+        bench_sink = (u64)sum;
+    });
+
+    printf("eval, ns per evaluation: parse and evaluate %.1f, ast_evaluate %.1f, bytecode_run %.1f\n", parse, tree, vm);
+
+    bytecode_deinit(&program);
+    parser_deinit(&parser);
+    lexer_deinit(&lexer);
+}
+
+int main(int argc, char **argv) {
+    if (wants("tables", argc, argv)) { bench_tables(); }
+    if (wants("churn",  argc, argv)) { bench_churn(); }
+    if (wants("batch",  argc, argv)) { bench_batch(); }
+    if (wants("hash",   argc, argv)) { bench_hash(); }
+    if (wants("eval",   argc, argv)) { bench_eval(); }
+    return 0;
+}
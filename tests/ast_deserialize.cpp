@@ -0,0 +1,135 @@
+/**
+   Test of ast_deserialize on good and malformed blocks. Not part of the front end, build it on its own from
+   the repository root:
+
+       g++ -std=c++17 -O2 -I. tests/ast_deserialize.cpp Ast.cpp Arena.cpp Common.cpp -o ast_deserialize
+
+   A tree with every kind of node has to come back equal from ast_serialize. Truncated blocks, blocks with a
+   byte too many and headers whose sizes don't add up (including ones which only add up after wrapping
+   around) have to be refused. Randomly corrupted blocks have to be either refused or give a tree which
+   survives another round trip. Build it with -fsanitize=address as well to catch reads out of bounds.
+
+   Exits with 1 on the first failure.
+**/
+
+#include "Types.h"
+#include "Ast.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const s32 CORRUPTED_BLOCKS = 20000;
+
+// Same as Ast_Serialized_Header in Ast.cpp.
+struct Header {
+    u32 magic;
+    u32 reserved;
+    u64 count;
+    u64 strings_count;
+};
+
+const u32 MAGIC = 0x54534124;
+
+static u64 random_state = 0x9e3779b97f4a7c15ull;
+
+static u32 random_below(u32 count) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (u32)((random_state * 0x2545f4914f6cdd1dull) >> 32) % count;
+}
+
+static void check(bool condition, const char *what) {
+    if (condition) { return; }
+    printf("FAILED: %s\n", what);
+    exit(1);
+}
+
+// Serializes tree and deserializes it again, which has to give the same nodes and strings.
+static bool round_trips(Ast_Tree *tree) {
+    void *data;
+    s64 size = ast_serialize(tree, &data);
+
+    Ast_Tree copy;
+    bool same = ast_deserialize(&copy, data, size) &&
+                copy.count == tree->count && copy.strings_count == tree->strings_count &&
+                memcmp(copy.kinds, tree->kinds, tree->count) == 0 &&
+                memcmp(copy.payloads, tree->payloads, tree->count * sizeof(Ast_Payload)) == 0 &&
+                (tree->strings_count == 0 || memcmp(copy.strings, tree->strings, tree->strings_count) == 0);
+
+    ast_tree_deinit(&copy);
+    free(data);
+    return same;
+}
+
+// Must be refused, and leave a tree behind which can be deinitialized.
+static void check_refused(void *data, s64 size, const char *what) {
+    Ast_Tree tree;
+    bool accepted = ast_deserialize(&tree, data, size);
+    check(!accepted, what);
+    ast_tree_deinit(&tree);
+}
+
+static void check_header_refused(u64 count, u64 strings_count, s64 size, const char *what) {
+    u8 *data = (u8 *)calloc(size, 1);
+    Header header = {MAGIC, 0, count, strings_count};
+    memcpy(data, &header, sizeof(header));
+    check_refused(data, size, what);
+    free(data);
+}
+
+int main() {
+    // (x ? -"a string" : y + 2.5) % true, with a name and a string in the pool.
+    static char x[] = "x", y[] = "y", string[] = "a string";
+    Ast_Tree tree;
+    ast_tree_init(&tree);
+    Ast_Index condition = ast_add_identifier(&tree, 1, x, 1);
+    Ast_Index then      = ast_add_unary(&tree, AST_NEGATE, ast_add_string(&tree, string, 8));
+    Ast_Index left      = ast_add_identifier(&tree, 2, y, 1);
+    Ast_Index otherwise = ast_add_binary(&tree, AST_ADD, left, ast_add_float(&tree, 2.5));
+    Ast_Index choice    = ast_add_conditional(&tree, condition, then, otherwise);
+    ast_add_binary(&tree, AST_MODULO, choice, ast_add_bool(&tree, true));
+
+    void *data;
+    s64 size = ast_serialize(&tree, &data);
+
+    check(round_trips(&tree), "a serialized tree didn't come back the same");
+
+    for (s64 cut = 0; cut < size; ++cut) { check_refused(data, cut, "a truncated block was accepted"); }
+
+    u8 *longer = (u8 *)calloc(size + 1, 1);
+    memcpy(longer, data, size);
+    check_refused(longer, size + 1, "a block with a byte too many was accepted");
+    free(longer);
+
+    // Headers alone, 24 bytes. strings_count is what makes strings_offset + strings_count wrap around to 24.
+    check_header_refused(1, (u64)(24 - 40), 24, "strings_count wrapping around to the block size was accepted");
+    check_header_refused(1, ~0ull, 24, "a huge strings_count was accepted");
+    check_header_refused(1, 0, 24, "a header without the kinds and payloads was accepted");
+    check_header_refused(UINT32_MAX - 1, 0, 24, "a huge count was accepted");
+    check_header_refused(~0ull, 0, 24, "a count of -1 was accepted");
+    check_header_refused(0, 0, 24, "a count of 0 was accepted");
+
+    // Padding, the reserved field and unused payload bits can change without making the tree invalid.
+    u8 *corrupted = (u8 *)malloc(size);
+    s32 accepted = 0;
+    for (s32 i = 0; i < CORRUPTED_BLOCKS; ++i) {
+        memcpy(corrupted, data, size);
+        s32 flips = 1 + random_below(3);
+        for (s32 flip = 0; flip < flips; ++flip) { corrupted[random_below((u32)size)] ^= (u8)(1 << random_below(8)); }
+
+        Ast_Tree result;
+        if (ast_deserialize(&result, corrupted, size)) {
+            check(round_trips(&result), "a tree from a corrupted block didn't survive a round trip");
+            ++accepted;
+        }
+        ast_tree_deinit(&result);
+    }
+    free(corrupted);
+
+    printf("ok, %d of %d corrupted blocks were still valid trees\n", accepted, CORRUPTED_BLOCKS);
+    free(data);
+    ast_tree_deinit(&tree);
+    return 0;
+}
@@ -0,0 +1,159 @@
+/**
+   Stress test and scaling benchmark for Concurrent_Hash_Table. Not part of the front end, build it on its own
+   from the repository root:
+
+       g++ -std=c++17 -O2 -pthread -I. tests/concurrent_hash_table_stress.cpp Arena.cpp Common.cpp -o concurrent_hash_table_stress
+
+   The stress part starts a small table so every shard grows many times while the threads race. Every thread
+   calls table_find_or_add on all of the same keys (each in its own order) while table_add inserts disjoint
+   keys next to them. Afterwards every key must have been made exactly once, every thread must have gotten
+   the value that was made, and table_count must be exact.
+
+   The benchmark then times table_find_or_add on fresh keys and table_find_pointer on present ones with
+   1, 2, 4, ... threads up to the number of cores (at least 4).
+
+   Exits with 1 on the first failure.
+**/
+
+#include "Types.h"
+#include "Concurrent_Hash_Table.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+const s64 STRESS_KEYS    = 100003; // Prime, so every stride below visits every key.
+const s32 STRESS_ROUNDS  = 4;
+const s64 BENCHMARK_KEYS = 1 << 21;
+
+static void check(bool condition, const char *what) {
+    if (condition) { return; }
+    printf("FAILED: %s\n", what);
+    exit(1);
+}
+
+static u64 value_for(u64 key, s32 thread) { return (key << 8) | (u64)thread; }
+
+static void stress(s32 thread_count) {
+    Concurrent_Hash_Table<u64, u64> table;
+    table_init(&table);
+
+    std::atomic<s32> *made   = (std::atomic<s32> *)calloc(STRESS_KEYS, sizeof(std::atomic<s32>));
+    u64              *seen   = (u64 *)malloc(STRESS_KEYS * thread_count * sizeof(u64));
+    std::atomic<bool> go(false);
+    assert(made && seen);
+
+    std::thread *threads = new std::thread[thread_count];
+    for (s32 t = 0; t < thread_count; ++t) {
+        threads[t] = std::thread([&, t] {
+            while (!go.load(std::memory_order_acquire)) { std::this_thread::yield(); }
+
+            // Every thread walks the keys with its own odd stride so they collide on different keys each time.
+            s64 stride = 2 * t + 1;
+            for (s64 i = 0; i < STRESS_KEYS; ++i) {
+                u64 key = (u64)((i * stride) % STRESS_KEYS);
+                u64 value = table_find_or_add(&table, key, [&](u64 *, u64 *value_return) {
+                    made[key].fetch_add(1, std::memory_order_relaxed);
+                    *value_return = value_for(key, t);
+                });
+                seen[key * thread_count + t] = value;
+
+                // Keys past STRESS_KEYS are only ever added by one thread, with table_add.
+                if (i % thread_count == t) { table_add(&table, (u64)(STRESS_KEYS + i), value_for(STRESS_KEYS + i, t)); }
+            }
+        });
+    }
+    go.store(true, std::memory_order_release);
+    for (s32 t = 0; t < thread_count; ++t) { threads[t].join(); }
+    delete[] threads;
+
+    for (s64 key = 0; key < STRESS_KEYS; ++key) {
+        check(made[key].load() == 1, "a key was made more than once or never");
+
+        u64 *value = table_find_pointer(&table, (u64)key);
+        check(value != NULL, "a key added with table_find_or_add is missing");
+        check((*value >> 8) == (u64)key, "a key has somebody else's value");
+        for (s32 t = 0; t < thread_count; ++t) {
+            check(seen[key * thread_count + t] == *value, "two threads got different values for a key");
+        }
+    }
+    for (s64 i = 0; i < STRESS_KEYS; ++i) {
+        u64 *value = table_find_pointer(&table, (u64)(STRESS_KEYS + i));
+        check(value != NULL && (*value >> 8) == (u64)(STRESS_KEYS + i), "a key added with table_add is missing");
+    }
+    check(table_count(&table) == 2 * STRESS_KEYS, "table_count is off");
+
+    free(made);
+    free(seen);
+    table_deinit(&table);
+}
+
+// Runs work(thread) on thread_count threads started together, returns the seconds until the last one is done.
+template <typename Work>
+static double time_threads(s32 thread_count, Work work) {
+    std::atomic<bool> go(false);
+    std::thread *threads = new std::thread[thread_count];
+    for (s32 t = 0; t < thread_count; ++t) {
+        threads[t] = std::thread([&, t] {
+            while (!go.load(std::memory_order_acquire)) { std::this_thread::yield(); }
+            work(t);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (s32 t = 0; t < thread_count; ++t) { threads[t].join(); }
+    auto end = std::chrono::steady_clock::now();
+
+    delete[] threads;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void benchmark(s32 thread_count) {
+    Concurrent_Hash_Table<u64, u64> table;
+    table_init(&table);
+
+    // Each thread adds its own slice of the keys, then every thread looks all of them up.
+    s64 per_thread = BENCHMARK_KEYS / thread_count;
+    double add_seconds = time_threads(thread_count, [&](s32 t) {
+        for (s64 i = t * per_thread; i < (t + 1) * per_thread; ++i) {
+            table_find_or_add(&table, (u64)i, [](u64 *key, u64 *value) { *value = *key; });
+        }
+    });
+
+    std::atomic<u64> sum(0);
+    double find_seconds = time_threads(thread_count, [&](s32 t) {
+        u64 local = 0;
+        for (s64 i = 0; i < per_thread * thread_count; ++i) {
+            u64 key = (u64)((i * 7919 + t * per_thread) % (per_thread * thread_count));
+            local += *table_find_pointer(&table, key);
+        }
+        sum += local;
+    });
+
+    s64 adds  = per_thread * thread_count;
+    s64 finds = adds * thread_count;
+    printf("  %2d threads: find_or_add %7.1f M/s, find %7.1f M/s\n", thread_count,
+           adds / add_seconds / 1e6, finds / find_seconds / 1e6);
+
+    check(table_count(&table) == adds, "table_count is off");
+    table_deinit(&table);
+}
+
+int main() {
+    s32 cores = (s32)std::thread::hardware_concurrency();
+    if (cores < 4) { cores = 4; }
+
+    for (s32 round = 0; round < STRESS_ROUNDS; ++round) {
+        for (s32 thread_count = 2; thread_count <= 2 * cores; thread_count *= 2) { stress(thread_count); }
+    }
+    printf("stress: ok\n");
+
+    printf("benchmark, %lld keys:\n", (long long)BENCHMARK_KEYS);
+    for (s32 thread_count = 1; thread_count <= cores; thread_count *= 2) { benchmark(thread_count); }
+    return 0;
+}
@@ -0,0 +1,161 @@
+/**
+   Differential test of the JIT against the tree walk and the bytecode VM. Not part of the front end, build
+   it on its own from the repository root:
+
+       g++ -std=c++17 -O2 -I. tests/jit_differential.cpp Ast.cpp Bytecode.cpp Jit.cpp Arena.cpp Common.cpp -o jit_differential
+
+   Builds random expression trees straight with ast_add (so literals can be NaN, infinities and -0.0) and
+   runs each one over a set of variable values with zeros, NaNs and infinities in it, which gives plenty of
+   divisions by zero and fmods of special values. Every evaluator must give exactly the same f64 as
+   ast_evaluate, down to the sign of zero, any NaN matches any NaN:
+
+     - jit_compile, for the trees it takes,
+     - bytecode_compile and bytecode_run, for the trees it takes,
+     - Compiled_Expression, which has to fall back for %, conditionals and trees too deep for the JIT.
+
+   Exits with 1 after printing the first few mismatches.
+**/
+
+#include "Types.h"
+#include "Ast.h"
+#include "Bytecode.h"
+#include "Jit.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+const s32 DIFFERENTIAL_TREES     = 50000;
+const s32 DIFFERENTIAL_VARIABLES = 6;
+const s32 DIFFERENTIAL_MAX_DEPTH = 8;
+
+static u64 random_state = 0x9e3779b97f4a7c15ull;
+
+// xorshift64*, so the same trees come out on every platform.
+static u32 random_below(u32 count) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (u32)((random_state * 0x2545f4914f6cdd1dull) >> 32) % count;
+}
+
+static Ast_Index random_literal(Ast_Tree *tree) {
+    static const f64 floats[] = {0.0, -0.0, 0.5, 1.0, -1.5, 3.0, 1e300, -1e-310, INFINITY, -INFINITY, NAN};
+    static const u64 ints[]   = {0, 1, 2, 7, 10, 123456789012345678ull};
+
+    switch (random_below(3)) {
+        case 0:  return ast_add_float(tree, floats[random_below(sizeof(floats) / sizeof(floats[0]))]);
+        case 1:  return ast_add_int(tree, ints[random_below(sizeof(ints) / sizeof(ints[0]))]);
+        default: return ast_add_bool(tree, random_below(2));
+    }
+}
+
+static Ast_Index random_node(Ast_Tree *tree, s32 depth) {
+    static char names[DIFFERENTIAL_VARIABLES][2] = {"a", "b", "c", "d", "e", "f"};
+    static const Ast_Kind binary[] = {AST_ADD, AST_SUBTRACT, AST_MULTIPLY, AST_DIVIDE, AST_MODULO};
+
+    u32 choice = random_below(depth >= DIFFERENTIAL_MAX_DEPTH ? 2 : 10);
+    switch (choice) {
+        case 0: return random_literal(tree);
+        case 1: {
+            u32 atom = random_below(DIFFERENTIAL_VARIABLES);
+            return ast_add_identifier(tree, (Atom)atom, names[atom], 1);
+        }
+        case 2: return ast_add_unary(tree, AST_NEGATE, random_node(tree, depth + 1));
+        case 3: return ast_add_unary(tree, AST_PLUS,   random_node(tree, depth + 1));
+        case 4: {
+            // Rarely, since the JIT only does them through the fallback.
+            if (random_below(4)) { return random_literal(tree); }
+            Ast_Index condition = random_node(tree, depth + 1);
+            Ast_Index then      = random_node(tree, depth + 1);
+            Ast_Index otherwise = random_node(tree, depth + 1);
+            return ast_add_conditional(tree, condition, then, otherwise);
+        }
+        default: {
+            Ast_Kind kind   = binary[random_below(sizeof(binary) / sizeof(binary[0]))];
+            Ast_Index left  = random_node(tree, depth + 1);
+            Ast_Index right = random_node(tree, depth + 1);
+            return ast_add_binary(tree, kind, left, right);
+        }
+    }
+}
+
+// a - (b - (c - ...)) needs one more register per level, deep enough ones don't fit in the JIT's 16.
+static Ast_Index right_deep_chain(Ast_Tree *tree, s32 length) {
+    static char name[] = "a";
+    if (length == 0) { return ast_add_identifier(tree, 0, name, 1); }
+    Ast_Index left = ast_add_identifier(tree, 0, name, 1);
+    return ast_add_binary(tree, AST_SUBTRACT, left, right_deep_chain(tree, length - 1));
+}
+
+static bool same_f64(f64 a, f64 b) {
+    if (isnan(a) || isnan(b)) { return isnan(a) && isnan(b); }
+    return a == b && signbit(a) == signbit(b);
+}
+
+static s32 mismatches = 0;
+
+static void report(const char *evaluator, s32 tree_number, s32 row, f64 expected, f64 got) {
+    if (mismatches++ < 10) {
+        printf("tree %d, row %d: %s gave %.17g, ast_evaluate gave %.17g\n", tree_number, row, evaluator, got, expected);
+    }
+}
+
+int main() {
+    static f64 rows[][DIFFERENTIAL_VARIABLES] = {
+        {1.5, -2.0, 3.0, 0.25, 7.0, -0.5},
+        {0.0, -0.0, 0.0, 1.0, -1.0, 2.0},
+        {NAN, 1.0, INFINITY, -INFINITY, 0.0, 5.0},
+        {1e308, -1e308, 4.9e-324, 123456.789, -3.0, 0.0},
+        {INFINITY, INFINITY, -0.0, NAN, 1.0, 1.0},
+    };
+    const s32 row_count = sizeof(rows) / sizeof(rows[0]);
+
+    s32 jitted = 0, compiled = 0, methods[3] = {};
+    for (s32 t = 0; t < DIFFERENTIAL_TREES; ++t) {
+        Ast_Tree tree;
+        ast_tree_init(&tree);
+        Ast_Index root = t % 100 == 99 ? right_deep_chain(&tree, 10 + random_below(20)) : random_node(&tree, 0);
+
+        Jit_Function function;
+        bool has_jit = jit_compile(&function, &tree, root);
+        Bytecode program;
+        bool has_bytecode = bytecode_compile(&program, &tree, root);
+        Compiled_Expression expression;
+        compiled_expression_init(&expression, &tree, root);
+
+        jitted   += has_jit;
+        compiled += has_bytecode;
+        methods[expression.method]++;
+
+        for (s32 row = 0; row < row_count; ++row) {
+            f64 expected = ast_evaluate(&tree, root, rows[row], DIFFERENTIAL_VARIABLES);
+
+            if (has_jit) {
+                f64 got = function.entry(rows[row]);
+                if (!same_f64(expected, got)) { report("jit", t, row, expected, got); }
+            }
+            if (has_bytecode) {
+                f64 got = bytecode_run(&program, rows[row], DIFFERENTIAL_VARIABLES);
+                if (!same_f64(expected, got)) { report("bytecode", t, row, expected, got); }
+            }
+            f64 got = compiled_expression_run(&expression, rows[row], DIFFERENTIAL_VARIABLES);
+            if (!same_f64(expected, got)) { report("compiled expression", t, row, expected, got); }
+        }
+
+        compiled_expression_deinit(&expression);
+        if (has_bytecode) { bytecode_deinit(&program); }
+        jit_free(&function);
+        ast_tree_deinit(&tree);
+    }
+
+    printf("%d trees, jit took %d, bytecode took %d, compiled expressions: %d jit, %d bytecode, %d tree walk\n",
+           DIFFERENTIAL_TREES, jitted, compiled, methods[EVALUATE_JIT], methods[EVALUATE_BYTECODE], methods[EVALUATE_TREE]);
+
+    if (mismatches) {
+        printf("FAILED: %d mismatches\n", mismatches);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
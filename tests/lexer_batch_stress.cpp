@@ -0,0 +1,195 @@
+/**
+   Stress test and scaling benchmark for lexer_tokenize_files. Not part of the front end, build it on its own
+   from the repository root:
+
+       g++ -std=c++17 -O2 -pthread -I. tests/lexer_batch_stress.cpp Lexer_Batch.cpp Lexer.cpp Lexer_Simd.cpp Interner.cpp Arena.cpp Common.cpp -o lexer_batch_stress
+
+   Writes a few hundred generated source files to a temporary directory, with a missing file, an empty one
+   and some which don't lex mixed in. The bad files must come back failed with a message while every other
+   file must have exactly the tokens lexing it alone on one thread gives, with any number of threads.
+
+   The benchmark then lexes all of the files with 1, 2, 4, ... threads up to the number of cores (at least
+   4) and prints the throughput and the speedup over one thread.
+
+   Needs a POSIX system for mkdtemp. Exits with 1 on the first failure.
+**/
+
+#include "Types.h"
+#include "Lexer_Batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> // unlink, rmdir
+
+#include <chrono>
+#include <thread>
+
+const s32 STRESS_FILES      = 256;
+const s64 STRESS_FILE_BYTES = 128 * 1024;
+const s32 BENCHMARK_RUNS    = 3;
+
+static u64 random_state = 0x9e3779b97f4a7c15ull;
+
+static u32 random_below(u32 count) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (u32)((random_state * 0x2545f4914f6cdd1dull) >> 32) % count;
+}
+
+static void check(bool condition, const char *what, char *file_name) {
+    if (condition) { return; }
+    printf("FAILED: %s (%s)\n", what, file_name);
+    exit(1);
+}
+
+// Roughly source shaped: identifiers, keywords, numbers, strings, operators, comments and line breaks.
+static void write_source(char *file_name, s64 size) {
+    static const char *pieces[] = {
+        "count", "index", "value_2", "x", "if", "return", "while", "u64", "main", "123", "0x7f", "0b101", "3.25",
+        "1e-3", "'a'", "\"a string\"", " + ", " - ", " * ", " / ", " = ", " == ", "(", ")", "{", "}", ";", ",",
+        " ", "    ", "\n", "// comment\n", "/* block\n comment */",
+    };
+    const u32 piece_count = sizeof(pieces) / sizeof(pieces[0]);
+
+    FILE *file = fopen(file_name, "wb");
+    check(file != NULL, "couldn't write a test file", file_name);
+
+    s64 written = 0;
+    while (written < size) {
+        const char *piece = pieces[random_below(piece_count)];
+        fputs(piece, file);
+        written += strlen(piece);
+        // Keep identifiers and numbers from running into each other.
+        fputc(' ', file);
+        ++written;
+    }
+    fclose(file);
+}
+
+static void write_text(char *file_name, const char *text) {
+    FILE *file = fopen(file_name, "wb");
+    check(file != NULL, "couldn't write a test file", file_name);
+    fputs(text, file);
+    fclose(file);
+}
+
+static bool same_token(Token *a, Token *b) {
+    if (a->type != b->type || a->position.offset != b->position.offset) { return false; }
+    if (a->position.line_start != b->position.line_start || a->position.column_start != b->position.column_start) { return false; }
+    switch ((s32)a->type) {
+        case Token_Type::TOKEN_IDENT:  return strcmp(a->ident_name, b->ident_name) == 0;
+        case Token_Type::TOKEN_STRING: return a->string_value.count == b->string_value.count &&
+                                              memcmp(a->string_value.data, b->string_value.data, a->string_value.count) == 0;
+        case Token_Type::TOKEN_FLOAT:  return memcmp(&a->f64_value, &b->f64_value, sizeof(f64)) == 0;
+        case Token_Type::TOKEN_CHAR:   return a->character_value == b->character_value;
+        case Token_Type::TOKEN_INT:    return a->integer_value == b->integer_value;
+    }
+    return true;
+}
+
+// Lexes the file alone with the plain lexer, the batch has to give exactly these tokens.
+static void check_against_single(Lexed_File *file) {
+    Lexer lexer;
+    lexer_init(&lexer);
+    lexer_set_input_from_file(&lexer, file->file_name);
+    Token_Buffer expected;
+    token_buffer_init(&expected);
+    lexer_tokenize_all(&lexer, &expected);
+
+    check(file->tokens.count == expected.count, "token count differs from lexing the file alone", file->file_name);
+    for (s64 i = 0; i < expected.count; ++i) {
+        Token a, b;
+        token_buffer_get(&file->tokens, i, &a);
+        token_buffer_get(&expected, i, &b);
+        check(same_token(&a, &b), "a token differs from lexing the file alone", file->file_name);
+    }
+
+    token_buffer_deinit(&expected);
+    lexer_deinit(&lexer);
+}
+
+int main() {
+    char directory[] = "/tmp/lexer_batch_XXXXXX";
+    check(mkdtemp(directory) != NULL, "couldn't make a temporary directory", directory);
+
+    // The bad files are spread out so they land on different workers.
+    s32 file_count = STRESS_FILES;
+    char **file_names = (char **)malloc(file_count * sizeof(char *));
+    s32 expected_failures = 0;
+    for (s32 i = 0; i < file_count; ++i) {
+        file_names[i] = (char *)malloc(64);
+        snprintf(file_names[i], 64, "%s/file_%d.txt", directory, i);
+
+        if (i % 64 == 13)      { ++expected_failures; continue; }  // Never written, so missing.
+        else if (i % 64 == 27) { write_text(file_names[i], "x = \"never closed"); ++expected_failures; }
+        else if (i % 64 == 41) { write_text(file_names[i], "y = 0x;\n");          ++expected_failures; }
+        else if (i % 64 == 55) { write_text(file_names[i], ""); }
+        else                   { write_source(file_names[i], STRESS_FILE_BYTES); }
+    }
+
+    Lexed_File *results = new Lexed_File[file_count];
+
+    s32 cores = (s32)std::thread::hardware_concurrency();
+    if (cores < 4) { cores = 4; }
+
+    for (s32 thread_count = 1; thread_count <= 2 * cores; thread_count *= 2) {
+        s32 failures = lexer_tokenize_files(file_names, file_count, thread_count, results);
+        check(failures == expected_failures, "the wrong number of files failed", directory);
+
+        for (s32 i = 0; i < file_count; ++i) {
+            Lexed_File *file = &results[i];
+            check(file->file_name == file_names[i], "results are out of order", file_names[i]);
+            check(file->tokens.count > 0, "a file has no tokens at all", file->file_name);
+
+            Token_Type last = file->tokens.types[file->tokens.count - 1];
+            if (i % 64 == 13 || i % 64 == 27 || i % 64 == 41) {
+                check(file->failed, "a bad file didn't fail", file->file_name);
+                check(file->error_message[0] != '\0', "a failed file has no message", file->file_name);
+                check(last == Token_Type::TOKEN_INVALID, "a failed file doesn't end in TOKEN_INVALID", file->file_name);
+            } else {
+                check(!file->failed, "a good file failed", file->file_name);
+                check(last == Token_Type::TOKEN_EOF, "a good file doesn't end in TOKEN_EOF", file->file_name);
+                check_against_single(file);
+            }
+        }
+        lexed_files_deinit(results, file_count);
+    }
+    printf("stress: ok\n");
+
+    s64 bytes = 0;
+    for (s32 i = 0; i < file_count; ++i) {
+        FILE *file = fopen(file_names[i], "rb");
+        if (!file) { continue; }
+        fseek(file, 0, SEEK_END);
+        bytes += ftell(file);
+        fclose(file);
+    }
+
+    printf("benchmark, %d files, %lld MB:\n", file_count, (long long)(bytes >> 20));
+    double one_thread = 0;
+    for (s32 thread_count = 1; thread_count <= cores; thread_count *= 2) {
+        double best = 0;
+        for (s32 run = 0; run < BENCHMARK_RUNS; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            lexer_tokenize_files(file_names, file_count, thread_count, results);
+            auto end = std::chrono::steady_clock::now();
+            lexed_files_deinit(results, file_count);
+
+            double seconds = std::chrono::duration<double>(end - start).count();
+            if (run == 0 || seconds < best) { best = seconds; }
+        }
+        if (thread_count == 1) { one_thread = best; }
+        printf("  %2d threads: %7.1f MB/s, %4.2fx one thread\n", thread_count, bytes / best / (1 << 20), one_thread / best);
+    }
+
+    for (s32 i = 0; i < file_count; ++i) {
+        unlink(file_names[i]);
+        free(file_names[i]);
+    }
+    rmdir(directory);
+    free(file_names);
+    delete[] results;
+    return 0;
+}